@@ -2,294 +2,430 @@
 #define BUFFER_H
 
 #include <stdint.h>
+#include "config.h"
+#include "latency.h"
+#include "keycodes.h"
 
 // ============= CONFIGURACIÓN DEL BUFFER =============
-#define BUFFER_SIZE 32  // Tamaño del buffer circular
+#define BUFFER_SIZE KEY_BUFFER_SIZE  // Tamaño del buffer circular (potencia de 2)
 
 // Estructura para eventos de teclas
 struct KeyEvent {
   uint8_t keycode;      // Código de la tecla
   bool isPressed;       // true = presionada, false = liberada
+  uint8_t repeat;       // Veces a enviar (>1 si se fusionaron repeticiones)
   unsigned long timestamp;  // Cuándo ocurrió
+  LatencyTrace trace;       // Muestreo, aceptación y encolado (us)
+
+  // Fusionar las repeticiones de la misma tecla (OVERFLOW_COALESCE)
+  bool merge(const KeyEvent& other) {
+    if(other.keycode != keycode || other.isPressed != isPressed ||
+       repeat + other.repeat > 255) {
+      return false;
+    }
+    repeat += other.repeat;
+    return true;
+  }
 };
 
-// ============= CLASE BUFFER CIRCULAR =============
-class CircularBuffer {
+// ============= RING SPSC SIN BLOQUEOS =============
+// Un solo productor y un solo consumidor, que pueden ser una ISR y el loop.
+// head (free-running) solo lo escribe el productor y tail solo el consumidor;
+// no hay contador compartido, así que ningún lado necesita deshabilitar
+// interrupciones. SIZE debe ser potencia de 2 para indexar con máscara.
+//
+// Política al llenarse:
+//   OVERFLOW_REJECT    - se descarta el evento nuevo
+//   OVERFLOW_OVERWRITE - el productor sigue escribiendo; el consumidor salta
+//                        los eventos pisados (se pierden los más antiguos)
+//   OVERFLOW_COALESCE  - el evento nuevo se fusiona con el más reciente si
+//                        T::merge() lo acepta; si no, se descarta. Solo es
+//                        seguro si el consumidor no interrumpe al productor.
+enum OverflowPolicy {
+  OVERFLOW_REJECT,
+  OVERFLOW_OVERWRITE,
+  OVERFLOW_COALESCE
+};
+
+// Barrera de compilador: publicar el dato antes que el índice
+#define RING_BARRIER() __asm__ volatile("" ::: "memory")
+
+// T::merge() solo se exige a los tipos usados con OVERFLOW_COALESCE
+template<typename T, bool COALESCE>
+struct RingMerge {
+  static bool merge(T& newest, const T& item) { return false; }
+};
+
+template<typename T>
+struct RingMerge<T, true> {
+  static bool merge(T& newest, const T& item) { return newest.merge(item); }
+};
+
+template<typename T, uint16_t SIZE, OverflowPolicy POLICY>
+class SpscRing {
 private:
-  KeyEvent buffer[BUFFER_SIZE];
-  volatile uint8_t head;  // Donde se escribe
-  volatile uint8_t tail;  // Donde se lee
-  volatile uint8_t count; // Elementos en el buffer
-  
+  static_assert(SIZE >= 2 && (SIZE & (SIZE - 1)) == 0, "SIZE debe ser potencia de 2");
+  static const uint16_t MASK = SIZE - 1;
+
+  T buffer[SIZE];
+  volatile uint16_t head;     // Escrito solo por el productor
+  volatile uint16_t tail;     // Escrito solo por el consumidor
+
+  // Estadísticas, cada una con un único escritor
+  volatile uint16_t peak;             // Productor: máximo de elementos en cola
+  volatile unsigned long rejected;    // Productor
+  volatile unsigned long coalesced;   // Productor
+  volatile unsigned long overwritten; // Consumidor
+
+  uint16_t used() {
+    return (uint16_t)(head - tail);
+  }
+
+  // OVERFLOW_OVERWRITE: descartar lo que el productor ya pisó
+  void skipOverwritten() {
+    uint16_t pending = used();
+    if(pending > SIZE) {
+      overwritten += pending - SIZE;
+      tail = head - SIZE;
+    }
+  }
+
 public:
-  CircularBuffer() {
-    clear();
+  SpscRing() :
+    head(0), tail(0), peak(0), rejected(0), coalesced(0), overwritten(0) {}
+
+  // ---- Lado productor ----
+  bool push(const T& item) {
+    uint16_t h = head;
+    uint16_t pending = (uint16_t)(h - tail);
+
+    if(pending >= SIZE) {
+      if(POLICY == OVERFLOW_REJECT) {
+        rejected++;
+        return false;
+      }
+
+      if(POLICY == OVERFLOW_COALESCE) {
+        if(RingMerge<T, POLICY == OVERFLOW_COALESCE>::merge(buffer[(h - 1) & MASK], item)) {
+          coalesced++;
+          return true;
+        }
+        rejected++;
+        return false;
+      }
+      // OVERFLOW_OVERWRITE: escribir igual, el consumidor lo detecta
+    }
+
+    buffer[h & MASK] = item;
+    RING_BARRIER();
+    head = h + 1;
+
+    if(pending + 1 > peak) {
+      peak = (pending + 1 > SIZE) ? SIZE : pending + 1;
+    }
+    return true;
   }
-  
-  // Limpiar buffer
-  void clear() {
-    head = 0;
-    tail = 0;
-    count = 0;
+
+  // ---- Lado consumidor ----
+  bool pop(T* item) {
+    while(true) {
+      if(POLICY == OVERFLOW_OVERWRITE) skipOverwritten();
+
+      uint16_t t = tail;
+      if(t == head) return false;
+
+      *item = buffer[t & MASK];
+      RING_BARRIER();
+
+      // Si el productor dio la vuelta mientras se copiaba, reintentar
+      if(POLICY == OVERFLOW_OVERWRITE && (uint16_t)(head - t) > SIZE) continue;
+
+      tail = t + 1;
+      return true;
+    }
   }
-  
-  // Verificar si está vacío
-  bool isEmpty() {
-    return count == 0;
+
+  bool peek(T* item) {
+    if(POLICY == OVERFLOW_OVERWRITE) skipOverwritten();
+    if(isEmpty()) return false;
+
+    *item = buffer[tail & MASK];
+    return true;
   }
-  
-  // Verificar si está lleno
-  bool isFull() {
-    return count >= BUFFER_SIZE;
+
+  // Vaciar desde el consumidor
+  void clear() {
+    tail = head;
   }
-  
-  // Cantidad de elementos
-  uint8_t getCount() {
-    return count;
+
+  bool isEmpty() { return head == tail; }
+  bool isFull() { return used() >= SIZE; }
+
+  uint16_t getCount() {
+    uint16_t pending = used();
+    return pending > SIZE ? SIZE : pending;
   }
-  
-  // Espacio disponible
-  uint8_t getSpace() {
-    return BUFFER_SIZE - count;
+
+  uint16_t getSpace() { return SIZE - getCount(); }
+  uint16_t getCapacity() { return SIZE; }
+
+  // Eventos perdidos por la política de desborde
+  unsigned long getOverflows() { return rejected + overwritten; }
+  unsigned long getCoalesced() { return coalesced; }
+  uint16_t getPeak() { return peak; }
+
+  void getStats(uint16_t* elements, uint16_t* highWater, unsigned long* overflows) {
+    *elements = getCount();
+    *highWater = peak;
+    *overflows = getOverflows();
   }
-  
-  // Agregar evento al buffer
-  bool push(uint8_t keycode, bool pressed) {
-    // Si está lleno, descartar el más antiguo
-    if(isFull()) {
-      // Opcional: podrías registrar esto como overflow
-      tail = (tail + 1) % BUFFER_SIZE;
-      count--;
-    }
-    
-    // Agregar nuevo evento
-    buffer[head].keycode = keycode;
-    buffer[head].isPressed = pressed;
-    buffer[head].timestamp = millis();
-    
-    head = (head + 1) % BUFFER_SIZE;
-    count++;
-    
-    return true;
+
+  void resetPeak() {
+    peak = getCount();
   }
-  
-  // Agregar solo evento de tecla presionada
-  bool pushKey(uint8_t keycode) {
-    return push(keycode, true);
+};
+
+// ============= BUFFER DE TECLAS =============
+// Cola del loop hacia el KeyTransmitter. Al llenarse, las teclas repetidas
+// (ráfagas de un encoder) se acumulan en 'repeat' del evento más reciente.
+// Además de eventos cuenta teclas (sumando 'repeat'), con un contador por
+// lado como los índices del ring.
+class CircularBuffer : public SpscRing<KeyEvent, BUFFER_SIZE, KEY_BUFFER_POLICY> {
+private:
+  unsigned long queuedKeys;   // Productor
+  unsigned long takenKeys;    // Consumidor
+
+public:
+  CircularBuffer() : queuedKeys(0), takenKeys(0) {}
+
+  bool push(uint8_t keycode, bool pressed) {
+    unsigned long now = micros();
+    return push(keycode, pressed, now, now);
   }
-  
-  // Obtener siguiente evento sin removerlo
-  bool peek(KeyEvent* event) {
-    if(isEmpty()) {
-      return false;
-    }
-    
-    *event = buffer[tail];
+
+  // Con los instantes en que la entrada se muestreó y se aceptó (us)
+  bool push(uint8_t keycode, bool pressed, unsigned long sampleTime, unsigned long acceptTime,
+            uint8_t repeat = 1) {
+    KeyEvent event;
+    event.keycode = keycode;
+    event.isPressed = pressed;
+    event.repeat = repeat;
+    event.timestamp = millis();
+    event.trace.sample = sampleTime;
+    event.trace.accept = acceptTime;
+    event.trace.enqueue = micros();
+    if(!SpscRing::push(event)) return false;
+
+    queuedKeys += repeat;
     return true;
   }
-  
-  // Obtener y remover siguiente evento
+
   bool pop(KeyEvent* event) {
-    if(isEmpty()) {
-      return false;
-    }
-    
-    *event = buffer[tail];
-    tail = (tail + 1) % BUFFER_SIZE;
-    count--;
-    
+    if(!SpscRing::pop(event)) return false;
+
+    takenKeys += event->repeat;
+    // Vacío: resincronizar (con OVERFLOW_OVERWRITE los eventos pisados
+    // nunca se sacan). El productor es el loop, no una ISR.
+    if(isEmpty()) takenKeys = queuedKeys;
     return true;
   }
-  
-  // Procesar todos los eventos pendientes
-  uint8_t processAll(void (*callback)(KeyEvent*)) {
-    uint8_t processed = 0;
-    KeyEvent event;
-    
-    while(pop(&event)) {
-      callback(&event);
-      processed++;
-    }
-    
-    return processed;
+
+  void clear() {
+    SpscRing::clear();
+    takenKeys = queuedKeys;
   }
-  
-  // Obtener estadísticas para debug
-  void getStats(uint8_t* head_pos, uint8_t* tail_pos, uint8_t* elements) {
-    *head_pos = head;
-    *tail_pos = tail;
-    *elements = count;
+
+  // Teclas en cola, contando las repeticiones de cada evento
+  uint16_t getKeyCount() {
+    if(isEmpty()) return 0;
+    unsigned long keys = queuedKeys - takenKeys;
+    return keys > 0xFFFF ? 0xFFFF : keys;
   }
-  
+
+  // Agregar solo evento de tecla presionada
+  bool pushKey(uint8_t keycode) {
+    return push(keycode, true);
+  }
+
+  bool pushKey(uint8_t keycode, unsigned long sampleTime, unsigned long acceptTime) {
+    return push(keycode, true, sampleTime, acceptTime);
+  }
+
+  // Varias pulsaciones de la misma tecla en un solo evento (pasos de un
+  // encoder); el KeyTransmitter las expande a ritmo HID
+  bool pushRepeat(uint8_t keycode, uint8_t repeat, unsigned long sampleTime, unsigned long acceptTime) {
+    return push(keycode, true, sampleTime, acceptTime, repeat);
+  }
+
   // Verificar si hay eventos muy antiguos (posible problema)
   bool hasStaleEvents(unsigned long maxAge) {
-    if(isEmpty()) {
+    KeyEvent event;
+    if(!peek(&event)) {
       return false;
     }
-    
-    unsigned long now = millis();
-    unsigned long eventAge = now - buffer[tail].timestamp;
-    
-    return eventAge > maxAge;
+
+    return millis() - event.timestamp > maxAge;
   }
 };
 
-// ============= BUFFER PARA COMBOS/SECUENCIAS =============
-class ComboBuffer {
+// ============= SISTEMA DE PRIORIDADES =============
+// Cola por cubetas: un CircularBuffer FIFO por nivel de prioridad, así que
+// push y pop son O(1) y el orden dentro de cada nivel se conserva. Para que
+// las teclas de baja prioridad no esperen indefinidamente, cada
+// KEY_PRIORITY_AGING_MS de espera sube un nivel la cabeza de su cubeta,
+// hasta quedar un nivel por debajo de CRITICAL. A igual nivel efectivo gana
+// la tecla que está en su nivel original, así que la espera nunca adelanta
+// una tecla a otra de prioridad realmente mayor (HIGH y CRITICAL no se
+// dejan pasar). Entre dos teclas envejecidas gana la que espera hace más:
+// una LOW no queda detrás de un flujo continuo de NORMAL envejecidas.
+// Sigue siendo SPSC: cada cubeta tiene el mismo productor y consumidor.
+class PriorityKeyBuffer {
 private:
-  uint8_t keys[8];      // Máximo 8 teclas en combo
-  uint8_t count;
-  unsigned long firstKeyTime;
-  unsigned long lastKeyTime;
-  
+  static const uint8_t LEVELS = 4;   // CRITICAL, HIGH, NORMAL, LOW
+
+  CircularBuffer levels[LEVELS];
+  uint16_t peak;       // Productor: máximo de teclas en cola (todas las cubetas)
+
+  static uint8_t levelFor(uint8_t priority) {
+    if(priority <= PRIORITY_CRITICAL) return 0;
+    if(priority <= PRIORITY_HIGH) return 1;
+    if(priority <= PRIORITY_NORMAL) return 2;
+    return 3;
+  }
+
 public:
-  ComboBuffer() {
-    clear();
+  PriorityKeyBuffer() : peak(0) {}
+
+  // Agregar con prioridad explícita (0 = máxima)
+  bool push(uint8_t keycode, uint8_t priority = PRIORITY_NORMAL) {
+    unsigned long now = micros();
+    return push(keycode, priority, now, now);
   }
-  
-  void clear() {
-    count = 0;
-    firstKeyTime = 0;
-    lastKeyTime = 0;
-  }
-  
-  // Agregar tecla al combo
-  bool addKey(uint8_t keycode) {
-    if(count >= 8) {
-      return false;  // Combo muy largo
-    }
-    
+
+  bool push(uint8_t keycode, uint8_t priority, unsigned long sampleTime, unsigned long acceptTime) {
+    bool accepted = levels[levelFor(priority)].pushKey(keycode, sampleTime, acceptTime);
+
+    uint16_t count = getCount();
+    if(count > peak) peak = count;
+    return accepted;
+  }
+
+  // Agregar con la prioridad que corresponde a la tecla
+  bool pushKey(uint8_t keycode) {
+    return push(keycode, keyPriority(keycode));
+  }
+
+  bool pushKey(uint8_t keycode, unsigned long sampleTime, unsigned long acceptTime) {
+    return push(keycode, keyPriority(keycode), sampleTime, acceptTime);
+  }
+
+  // Un evento con repeat pulsaciones, en la cubeta de la tecla
+  bool pushRepeat(uint8_t keycode, uint8_t repeat, unsigned long sampleTime, unsigned long acceptTime) {
+    bool accepted = levels[levelFor(keyPriority(keycode))].pushRepeat(keycode, repeat, sampleTime, acceptTime);
+
+    uint16_t count = getCount();
+    if(count > peak) peak = count;
+    return accepted;
+  }
+
+  // Obtener la tecla de mayor prioridad efectiva; a igualdad, la que no
+  // subió por espera o, si las dos subieron, la más antigua
+  bool pop(KeyEvent* event) {
+    int8_t best = -1;
+    int16_t bestRank = 0;
+    bool bestAged = false;
+    unsigned long bestAge = 0;
     unsigned long now = millis();
-    
-    // Si es la primera tecla o pasó mucho tiempo, reiniciar
-    if(count == 0 || (now - lastKeyTime) > 500) {
-      clear();
-      firstKeyTime = now;
+
+    for(uint8_t level = 0; level < LEVELS; level++) {
+      KeyEvent head;
+      if(!levels[level].peek(&head)) continue;
+
+      // Sube como máximo hasta el nivel 1; CRITICAL no se alcanza por espera
+      unsigned long age = now - head.timestamp;
+      unsigned long boost = age / KEY_PRIORITY_AGING_MS;
+      unsigned long maxBoost = level > 1 ? level - 1 : 0;
+      if(boost > maxBoost) boost = maxBoost;
+      int16_t rank = level - boost;
+
+      // Se recorre de mayor a menor prioridad: a igual rango solo desplaza
+      // al candidato si los dos envejecieron y esta espera hace más
+      bool aged = boost > 0;
+      if(best < 0 || rank < bestRank ||
+         (rank == bestRank && aged && bestAged && age > bestAge)) {
+        best = level;
+        bestRank = rank;
+        bestAged = aged;
+        bestAge = age;
+      }
     }
-    
-    keys[count++] = keycode;
-    lastKeyTime = now;
-    
-    return true;
+
+    if(best < 0) return false;
+    return levels[best].pop(event);
   }
-  
-  // Verificar si coincide con un patrón
-  bool matches(const uint8_t* pattern, uint8_t patternLength) {
-    if(count != patternLength) {
-      return false;
-    }
-    
-    for(uint8_t i = 0; i < count; i++) {
-      if(keys[i] != pattern[i]) {
-        return false;
-      }
+
+  bool isEmpty() {
+    for(uint8_t level = 0; level < LEVELS; level++) {
+      if(!levels[level].isEmpty()) return false;
     }
-    
     return true;
   }
-  
-  // Obtener duración del combo
-  unsigned long getDuration() {
-    if(count == 0) return 0;
-    return lastKeyTime - firstKeyTime;
-  }
-  
-  uint8_t getCount() {
+
+  uint16_t getCount() {
+    uint16_t count = 0;
+    for(uint8_t level = 0; level < LEVELS; level++) {
+      count += levels[level].getCount();
+    }
     return count;
   }
-  
-  // Timeout automático
-  bool checkTimeout(unsigned long timeout) {
-    if(count > 0 && (millis() - lastKeyTime) > timeout) {
-      clear();
-      return true;
+
+  uint16_t getCount(uint8_t priority) {
+    return levels[levelFor(priority)].getCount();
+  }
+
+  // Teclas en cola (un evento con repeat = n cuenta n)
+  uint16_t getKeyCount() {
+    uint16_t keys = 0;
+    for(uint8_t level = 0; level < LEVELS; level++) {
+      keys += levels[level].getKeyCount();
     }
-    return false;
+    return keys;
   }
-};
 
-// ============= SISTEMA DE PRIORIDADES =============
-class PriorityKeyBuffer {
-private:
-  struct PriorityEvent {
-    KeyEvent event;
-    uint8_t priority;  // 0 = máxima prioridad
-  };
-  
-  PriorityEvent buffer[BUFFER_SIZE];
-  uint8_t count;
-  
-public:
-  PriorityKeyBuffer() : count(0) {}
-  
-  // Agregar con prioridad
-  bool push(uint8_t keycode, uint8_t priority = 5) {
-    if(count >= BUFFER_SIZE) {
-      // Buscar y reemplazar el de menor prioridad
-      uint8_t lowestPriority = 0;
-      uint8_t lowestIndex = 0;
-      
-      for(uint8_t i = 0; i < count; i++) {
-        if(buffer[i].priority > lowestPriority) {
-          lowestPriority = buffer[i].priority;
-          lowestIndex = i;
-        }
-      }
-      
-      // Solo reemplazar si la nueva tiene mayor prioridad
-      if(priority < lowestPriority) {
-        buffer[lowestIndex].event.keycode = keycode;
-        buffer[lowestIndex].event.isPressed = true;
-        buffer[lowestIndex].event.timestamp = millis();
-        buffer[lowestIndex].priority = priority;
-        return true;
-      }
-      
-      return false;  // Buffer lleno y nueva tecla tiene menor prioridad
+  void clear() {
+    for(uint8_t level = 0; level < LEVELS; level++) {
+      levels[level].clear();
     }
-    
-    // Agregar al final
-    buffer[count].event.keycode = keycode;
-    buffer[count].event.isPressed = true;
-    buffer[count].event.timestamp = millis();
-    buffer[count].priority = priority;
-    count++;
-    
-    // Ordenar por prioridad
-    sortByPriority();
-    
-    return true;
   }
-  
-  // Obtener el de mayor prioridad
-  bool pop(KeyEvent* event) {
-    if(count == 0) {
-      return false;
+
+  // Verificar si hay eventos muy antiguos (posible problema)
+  bool hasStaleEvents(unsigned long maxAge) {
+    for(uint8_t level = 0; level < LEVELS; level++) {
+      if(levels[level].hasStaleEvents(maxAge)) return true;
     }
-    
-    *event = buffer[0].event;
-    
-    // Mover todos los demás una posición
-    for(uint8_t i = 1; i < count; i++) {
-      buffer[i-1] = buffer[i];
+    return false;
+  }
+
+  unsigned long getOverflows() {
+    unsigned long total = 0;
+    for(uint8_t level = 0; level < LEVELS; level++) {
+      total += levels[level].getOverflows();
     }
-    
-    count--;
-    return true;
+    return total;
   }
-  
-private:
-  void sortByPriority() {
-    // Bubble sort simple (suficiente para buffer pequeño)
-    for(uint8_t i = 0; i < count - 1; i++) {
-      for(uint8_t j = 0; j < count - i - 1; j++) {
-        if(buffer[j].priority > buffer[j+1].priority) {
-          PriorityEvent temp = buffer[j];
-          buffer[j] = buffer[j+1];
-          buffer[j+1] = temp;
-        }
-      }
+
+  unsigned long getCoalesced() {
+    unsigned long total = 0;
+    for(uint8_t level = 0; level < LEVELS; level++) {
+      total += levels[level].getCoalesced();
     }
+    return total;
+  }
+
+  uint16_t getPeak() { return peak; }
+
+  void resetPeak() {
+    peak = getCount();
   }
 };
 
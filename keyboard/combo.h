@@ -0,0 +1,240 @@
+#ifndef COMBO_H
+#define COMBO_H
+
+#include "config.h"
+
+// ============= COMBOS =============
+// Acordes de COMBOS (config.h) sobre la máscara de 16 bits del debounce.
+// Una tecla que forma parte de algún combo se retiene al presionarse; las
+// que lleguen dentro de COMBO_WINDOW_MS se suman a la máscara pendiente.
+// La máscara se resuelve:
+//   - apenas coincide con un combo que ningún otro extiende: dispara ya
+//   - al vencer la ventana, al soltar una de sus teclas o al presionar una
+//     tecla que no puede sumarse: dispara si coincide exacto, si no las
+//     teclas retenidas salen como pulsaciones normales, en orden. La tecla
+//     que interrumpe va en un reporte posterior (keyboard.ino)
+// Las teclas de un combo disparado no salen por el reporte: el combo vive
+// en su tecla más baja (la dueña) y termina al soltar cualquiera de ellas.
+//
+// Las teclas que no están en ningún combo pasan sin espera. La coincidencia
+// exacta es una búsqueda binaria en la tabla ordenada por máscara. Sin
+// COMBOS_ENABLED ninguna tecla es de un combo y el motor no retiene nada.
+
+constexpr uint16_t comboKeys() {
+  uint16_t keys = 0;
+  for(const ComboDef& combo : COMBOS) keys |= combo.keys;
+  return keys;
+}
+
+constexpr bool combosSorted() {
+  for(size_t i = 1; i < COMBO_COUNT; i++) {
+    if(COMBOS[i - 1].keys >= COMBOS[i].keys) return false;
+  }
+  return true;
+}
+
+static_assert(combosSorted(), "COMBOS debe estar ordenada por mascara, sin repetidos");
+
+constexpr uint16_t COMBO_KEYS = COMBOS_ENABLED ? comboKeys() : 0;
+
+enum ComboEventType {
+  COMBO_EVENT_PRESS,      // Tecla retenida que sale como pulsación normal
+  COMBO_EVENT_FIRE,       // Empieza el combo index en button (la dueña)
+  COMBO_EVENT_END         // Termina el combo index
+};
+
+struct ComboEvent {
+  uint8_t type;
+  uint8_t button;
+  uint8_t index;
+};
+
+#define COMBO_QUEUE_SIZE 32       // Potencia de 2
+
+class ComboEngine {
+private:
+  uint16_t pending;               // Retenidas dentro de la ventana
+  uint16_t consumed;              // Del combo disparado, hasta soltarse
+  unsigned long windowStart;
+  int8_t active;                  // Combo disparado; -1 = ninguno
+  uint8_t owner;
+
+  ComboEvent queue[COMBO_QUEUE_SIZE];
+  uint8_t head;
+  uint8_t tail;
+
+  // Estadísticas
+  unsigned long fired;
+  unsigned long flushed;
+
+  void emit(uint8_t type, uint8_t button, uint8_t index) {
+    if((uint8_t)(head - tail) >= COMBO_QUEUE_SIZE) return;
+
+    ComboEvent& event = queue[head % COMBO_QUEUE_SIZE];
+    event.type = type;
+    event.button = button;
+    event.index = index;
+    head++;
+  }
+
+  static int8_t find(uint16_t keys) {
+    int8_t low = 0, high = COMBO_COUNT - 1;
+    while(low <= high) {
+      int8_t mid = (low + high) / 2;
+      if(COMBOS[mid].keys == keys) return mid;
+      if(COMBOS[mid].keys < keys) {
+        low = mid + 1;
+      } else {
+        high = mid - 1;
+      }
+    }
+    return -1;
+  }
+
+  // ¿Algún combo contiene a keys (y alguno lo contiene estrictamente)?
+  static void reach(uint16_t keys, bool* partOf, bool* extendable) {
+    *partOf = false;
+    *extendable = false;
+    for(uint8_t i = 0; i < COMBO_COUNT; i++) {
+      if((COMBOS[i].keys & keys) != keys) continue;
+      *partOf = true;
+      if(COMBOS[i].keys != keys) {
+        *extendable = true;
+        return;
+      }
+    }
+  }
+
+  void fire(int8_t index) {
+    if(active >= 0) {
+      emit(COMBO_EVENT_END, owner, active);
+    }
+
+    active = index;
+    owner = __builtin_ctz(COMBOS[index].keys);
+    consumed |= COMBOS[index].keys;
+    pending = 0;
+    fired++;
+    emit(COMBO_EVENT_FIRE, owner, index);
+  }
+
+  void resolve() {
+    if(!pending) return;
+
+    int8_t index = find(pending);
+    if(index >= 0) {
+      fire(index);
+      return;
+    }
+
+    uint16_t keys = pending;
+    pending = 0;
+    while(keys) {
+      uint8_t i = __builtin_ctz(keys);
+      keys &= keys - 1;
+      emit(COMBO_EVENT_PRESS, i, 0);
+      flushed++;
+    }
+  }
+
+public:
+  ComboEngine() :
+    pending(0),
+    consumed(0),
+    windowStart(0),
+    active(-1),
+    owner(0),
+    head(0),
+    tail(0),
+    fired(0),
+    flushed(0) {}
+
+  // true: la tecla queda retenida (no procesarla todavía)
+  bool press(uint8_t button, unsigned long now) {
+    uint16_t bit = 1 << button;
+
+    if(pending && now - windowStart >= COMBO_WINDOW_MS) {
+      resolve();
+    }
+
+    if(!(COMBO_KEYS & bit)) {
+      resolve();
+      return false;
+    }
+
+    bool partOf, extendable;
+    reach(pending | bit, &partOf, &extendable);
+
+    if(!partOf) {
+      // No forma combo con las retenidas: resolverlas y empezar de nuevo
+      resolve();
+      reach(bit, &partOf, &extendable);
+    }
+
+    if(!pending) {
+      windowStart = now;
+    }
+    pending |= bit;
+
+    if(!extendable && find(pending) >= 0) {
+      resolve();
+    }
+    return true;
+  }
+
+  // true: el soltado no debe procesarse (tecla de un combo)
+  bool release(uint8_t button) {
+    uint16_t bit = 1 << button;
+
+    if(pending & bit) {
+      resolve();
+    }
+
+    if(!(consumed & bit)) return false;
+
+    consumed &= ~bit;
+    if(active >= 0 && (COMBOS[active].keys & bit)) {
+      emit(COMBO_EVENT_END, owner, active);
+      active = -1;
+    }
+    return true;
+  }
+
+  // Vencimiento de la ventana; llamar periódicamente
+  void update(unsigned long now) {
+    if(pending && now - windowStart >= COMBO_WINDOW_MS) {
+      resolve();
+    }
+  }
+
+  bool nextEvent(ComboEvent* event) {
+    if(head == tail) return false;
+    *event = queue[tail % COMBO_QUEUE_SIZE];
+    tail++;
+    return true;
+  }
+
+  // Teclas fuera del reporte: retenidas y de combos, salvo la dueña del
+  // combo activo, que lleva su código
+  uint16_t getSuppressed() {
+    uint16_t suppressed = pending | consumed;
+    if(active >= 0) {
+      suppressed &= ~(1 << owner);
+    }
+    return suppressed;
+  }
+
+  void clear() {
+    pending = 0;
+    consumed = 0;
+    active = -1;
+    tail = head;
+  }
+
+  void getStats(unsigned long* combosFired, unsigned long* keysFlushed) {
+    *combosFired = fired;
+    *keysFlushed = flushed;
+  }
+};
+
+#endif
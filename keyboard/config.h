@@ -34,39 +34,134 @@
 #define I2C_CHECK_INTERVAL 1000
 #define DEBUG_PRINT_INTERVAL 5000
 
+// Tareas del planificador (scheduler.h): periodo y plazo en microsegundos
+#define BUTTON_TASK_PERIOD_US (MAIN_LOOP_INTERVAL * 1000UL)
+#define BUTTON_TASK_DEADLINE_US 2000
+#define ENCODER_TASK_PERIOD_US 1000     // Más rápido que los botones
+#define ENCODER_TASK_DEADLINE_US 500
+#define SERIAL_TASK_PERIOD_US 10000
+#define STORAGE_TASK_PERIOD_US 100000
+#define I2C_CHECK_DEADLINE_US 100000
+#define DEBUG_TASK_DEADLINE_US 1000000
+
 // ============= CONFIGURACIÓN DE DEBOUNCE =============
-#define DEBOUNCE_SIMPLE true
+// Algoritmo de los botones (debounce.h); cada build lleva solo el elegido
+#define DEBOUNCE_EAGER 0          // Acepta el primer flanco y bloquea BUTTON_DEBOUNCE_TICKS
+#define DEBOUNCE_WINDOW 1         // DEBOUNCE_SAMPLES muestras seguidas
+#define DEBOUNCE_INTEGRATING 2    // Integrador saturado en DEBOUNCE_SAMPLES
+#define DEBOUNCE_ASYMMETRIC 3     // Ventanas distintas para presionar y soltar
+// Integrador de 3 ticks por defecto: en make bench es la única política sin
+// flancos falsos ni pulsaciones perdidas (eager deja pasar los glitches de
+// EMI y pierde pulsaciones durante el bloqueo), a costa de ~30 ms de latencia
+#ifndef BUTTON_DEBOUNCE_POLICY
+#define BUTTON_DEBOUNCE_POLICY DEBOUNCE_INTEGRATING
+#endif
 #define BUTTON_DEBOUNCE_DELAY 50
 #define ENCODER_DEBOUNCE_DELAY 5
-#define DEBOUNCE_SAMPLES 5
+#define DEBOUNCE_SAMPLES 3
+#define DEBOUNCE_PRESS_SAMPLES 1
+#define DEBOUNCE_RELEASE_SAMPLES 5
+#define BUTTON_DEBOUNCE_TICKS (BUTTON_DEBOUNCE_DELAY / MAIN_LOOP_INTERVAL)
 
 // ============= CONFIGURACIÓN PCF8575 =============
 #define PCF8575_ADDRESS 0x20
 #define PCF8575_MAX_RETRIES 3
 #define PCF8575_RETRY_DELAY 10
 
+// Escaneo por interrupción: INT del PCF8575 (open-drain, activo en LOW)
+// dispara una lectura inmediata; el sondeo queda como barrido de seguridad
+#ifndef PCF8575_INT_ENABLED
+#define PCF8575_INT_ENABLED false
+#endif
+#define PCF8575_INT_PIN PB8
+#define PCF8575_SAFETY_SCAN_INTERVAL 100
+
+// ============= CONFIGURACIÓN I2C =============
+#define I2C_CLOCK_SPEED 400000
+#define I2C_ASYNC_MAX_LENGTH 4
+#define I2C_ASYNC_TIMEOUT_US 2000   // Una lectura de 2 bytes tarda ~70us a 400kHz
+
 // ============= CONFIGURACIÓN ENCODERS =============
 #define ENCODER_A_PIN1 PA0
 #define ENCODER_A_PIN2 PA1
 #define ENCODER_B_PIN1 PA2
 #define ENCODER_B_PIN2 PA3
 
+// Decodificación por interrupción: EXTI en cada flanco de A y B (PA0-PA3
+// usan las líneas EXTI0-3, sin conflicto con el INT del PCF8575 en PB8)
+#ifndef ENCODER_ISR_ENABLED
+#define ENCODER_ISR_ENABLED false
+#endif
+#define ENCODER_STEP_QUEUE_SIZE 32   // Potencia de 2
+
+// Sobremuestreo por DMA: TIM3 dispara DMA1 canal 3, que copia GPIOA->IDR a
+// un buffer circular; el lote se decodifica una vez por tick sin ISR por flanco
+#ifndef ENCODER_DMA_SAMPLING
+#define ENCODER_DMA_SAMPLING false
+#endif
+#define ENCODER_SAMPLE_RATE 10000        // Hz
+#define ENCODER_SAMPLE_BUFFER_SIZE 128   // Potencia de 2; 12.8ms a 10kHz
+#define ENCODER_FILTER_SAMPLES 3         // Muestras iguales para aceptar un estado
+
+#if ENCODER_ISR_ENABLED && ENCODER_DMA_SAMPLING
+#error "ENCODER_ISR_ENABLED y ENCODER_DMA_SAMPLING son excluyentes"
+#endif
+
+// Aceleración: ganancia (pasos de salida por paso físico, Q8: 256 = 1x)
+// según el intervalo medio entre pasos, interpolada entre los puntos de la
+// curva. La fracción se acumula: a 1.5x salen 3 pasos por cada 2 físicos.
+// Cada paso es una tecla de ~15 ms, así que la curva solo pasa de 1x en
+// giros muy rápidos y la cola de un encoder se limita aparte
+#define ENCODER_ACCEL_ENABLED true
+#define ENCODER_ACCEL_SMOOTHING 1        // Peso del intervalo nuevo: 1/2^n
+#define ENCODER_ACCEL_IDLE_US 200000UL   // Sin pasos por más tiempo: vuelve a 1x
+#define ENCODER_MAX_PENDING_KEYS 16      // Teclas en cola tras las que se descartan pasos
+
+struct EncoderAccelPoint {
+  unsigned long intervalUs;
+  uint16_t gain;                  // Q8
+};
+
+// Intervalos crecientes; fuera del rango se usa el punto del extremo
+constexpr EncoderAccelPoint ENCODER_ACCEL_CURVE[] = {
+  { 2000, 512},     // 2x: más de 500 pasos/s
+  { 6000, 256}      // 1x: giros lentos y medios
+};
+#define ENCODER_ACCEL_POINTS (sizeof(ENCODER_ACCEL_CURVE) / sizeof(ENCODER_ACCEL_CURVE[0]))
+
 // ============= CONFIGURACIÓN USB HID =============
 #define USB_POLL_INTERVAL 1
 #define KEY_PRESS_DURATION 10
 #define KEY_RELEASE_DELAY 5
 
+// Reporte N-key rollover (bitmap) por una interfaz HID agregada al
+// compuesto del core (report.cpp). Con el host en protocolo de arranque se
+// vuelve al reporte de 6 teclas.
+#ifndef HID_NKRO_ENABLED
+#define HID_NKRO_ENABLED false
+#endif
+
 // ============= CONFIGURACIÓN DE BUFFER =============
-#define KEY_BUFFER_SIZE 32
+#define KEY_BUFFER_SIZE 32          // Potencia de 2
+#define KEY_BUFFER_POLICY OVERFLOW_COALESCE
+#define KEY_PRIORITY_AGING_MS 50    // Espera que sube un nivel de prioridad
 #define BUFFER_OVERFLOW_THRESHOLD 24
-#define COMBO_TIMEOUT 500
-#define MAX_COMBO_LENGTH 8
+#define COMBO_TIMEOUT 500           // Espera máxima entre teclas de una secuencia líder
+#define MAX_COMBO_LENGTH 8          // Teclas por secuencia líder
 
 // ============= CONFIGURACIÓN MODO CONFIG =============
 #define CONFIG_MODE_ENABLED true
 #define CONFIG_ENTRY_KEYS {0, 11}
 #define CONFIG_HOLD_TIME 3000
 #define CONFIG_TIMEOUT 10000
+#define CONFIG_OUTPUT_QUEUE_SIZE 256  // Teclas de texto pendientes (potencia de 2)
+#define CONFIG_LINE_MAX 40            // Largo máximo de la línea editable
+#define CONFIG_OUTPUT_MAX_PENDING 4   // Teclas de texto a la vez en el buffer de teclas
+
+// ============= PERFILES =============
+#define PROFILE_COUNT 4                 // Mapeos guardados (comando serie '1'-'4')
+#define PROFILE_SWITCH_KEYS ((1 << 14) | (1 << 15))  // Acorde que pasa al siguiente perfil
+#define PROFILE_SWITCH_WINDOW_MS 40     // Espera de cada tecla del acorde por las demás
 
 // ============= MAPEO DE TECLAS =============
 struct KeyMap {
@@ -106,27 +201,173 @@ EncoderMap ENCODER_MAP[2] = {
   {'b', 'n', "Encoder B"}
 };
 
+// ============= CAPAS =============
+// Capas por encima de BUTTON_MAP/ENCODER_MAP (layers.h). La capa 0 es el
+// perfil activo: donde su fila tiene ____ se usa BUTTON_MAP, y cualquier
+// otra entrada lo reemplaza (por ejemplo MO(1) en un botón para tener una
+// tecla de función). En las capas superiores ____ deja ver la de abajo;
+// la tecla que activa una capa debe quedar en ____ dentro de esa capa.
+#define LAYER_COUNT 3
+
+enum LayerActionType {
+  LAYER_ACTION_KEY,           // Tecla normal (arg = keycode)
+  LAYER_ACTION_TRANSPARENT,   // Usar la capa de abajo
+  LAYER_ACTION_NONE,          // Botón sin función en esta capa
+  LAYER_ACTION_MOMENTARY,     // Capa arg activa mientras se mantiene
+  LAYER_ACTION_TOGGLE,        // Activa/desactiva la capa arg
+  LAYER_ACTION_ONESHOT,       // Capa arg solo para la próxima tecla
+  LAYER_ACTION_MACRO_PLAY,    // Reproducir la macro arg (macro.h)
+  LAYER_ACTION_MACRO_RECORD,  // Empezar/terminar de grabar la macro arg
+  LAYER_ACTION_TAP_DANCE,     // Toque/mantener/multitoque TAP_DANCES[arg]
+  LAYER_ACTION_LEADER         // Empezar una secuencia de LEADER_SEQUENCES
+};
+
+struct LayerKey {
+  uint8_t type;
+  uint8_t arg;
+};
+
+#define ____    {LAYER_ACTION_TRANSPARENT, 0}
+#define XXXX    {LAYER_ACTION_NONE, 0}
+#define KC(k)   {LAYER_ACTION_KEY, (uint8_t)(k)}
+#define MO(l)   {LAYER_ACTION_MOMENTARY, (l)}
+#define TG(l)   {LAYER_ACTION_TOGGLE, (l)}
+#define OSL(l)  {LAYER_ACTION_ONESHOT, (l)}
+#define MPLAY(m) {LAYER_ACTION_MACRO_PLAY, (m)}
+#define MREC(m)  {LAYER_ACTION_MACRO_RECORD, (m)}
+#define TD(n)    {LAYER_ACTION_TAP_DANCE, (n)}
+#define LEAD     {LAYER_ACTION_LEADER, 0}
+
+// ============= TOQUE / MANTENER =============
+#define TAP_HOLD_TERM_MS 200        // Mantener más que esto = acción de mantener
+#define TAP_DANCE_TERM_MS 200       // Espera por otro toque tras soltar
+#define TAP_HOLD_ON_OTHER_KEY 1     // Otra tecla durante la espera decide mantener
+#define TAP_DANCE_MAX_TAPS 3
+
+// Código por cantidad de toques (0 = no definido) y acción al mantener
+// (KC o MO; XXXX = ninguna). Ver tapdance.h.
+struct TapDanceKey {
+  uint8_t taps[TAP_DANCE_MAX_TAPS];
+  LayerKey hold;
+};
+
+constexpr TapDanceKey TAP_DANCES[] = {
+  // 0: Esc al tocar, capa 2 mientras se mantiene
+  {{KEY_ESC, 0, 0}, MO(2)},
+  // 1: Tab, dos toques Enter; Shift mientras se mantiene
+  {{KEY_TAB, KEY_RETURN, 0}, KC(KEY_LEFT_SHIFT)},
+  // 2: 'a', 'b' o 'c' según la cantidad de toques
+  {{'a', 'b', 'c'}, XXXX},
+};
+
+#define TAP_DANCE_COUNT (sizeof(TAP_DANCES) / sizeof(TAP_DANCES[0]))
+
+// Ejemplo: TD(0)-TD(2) en F4-F6 de la capa 0. Desactivado por defecto, como
+// los combos; el binario de traces/combos/ del simulador lo activa
+#ifndef TAP_DANCE_EXAMPLE
+#define TAP_DANCE_EXAMPLE false
+#endif
+#if TAP_DANCE_EXAMPLE
+#define TD_EXAMPLE(n) TD(n)
+#else
+#define TD_EXAMPLE(n) ____
+#endif
+
+// ============= COMBOS =============
+// Desactivados por defecto: cada botón que aparece en COMBOS espera
+// COMBO_WINDOW_MS al presionarse, y sus acordes ya no envían las teclas
+// propias. La tabla de abajo es un ejemplo sobre F7-F12.
+#ifndef COMBOS_ENABLED
+#define COMBOS_ENABLED false
+#endif
+#define COMBO_WINDOW_MS 40          // Ventana para presionar todas las teclas
+
+// Botones presionados juntos (bit n = botón n) y la acción que producen.
+// Ordenada por máscara. Ver combo.h.
+struct ComboDef {
+  uint16_t keys;
+  LayerKey action;
+};
+
+constexpr ComboDef COMBOS[] = {
+  {(1 << 6) | (1 << 7), TG(1)},                 // F7+F8: capa de números
+  {(1 << 8) | (1 << 9), KC(KEY_ESC)},           // F9+F10: Esc
+  {(1 << 8) | (1 << 9) | (1 << 10), MPLAY(0)},  // F9+F10+F11: macro 1
+  {(1 << 10) | (1 << 11), LEAD},                // F11+F12: tecla líder
+};
+
+#define COMBO_COUNT (sizeof(COMBOS) / sizeof(COMBOS[0]))
+
+// ============= SECUENCIAS LÍDER =============
+// Teclas (códigos ya resueltos por capa, terminadas en 0) tras LEAD y la
+// acción que disparan: KC, TG, MPLAY o MREC. Se compilan a un trie en
+// flash (leader.h); el orden no importa. Solo se alcanzan con una tecla
+// LEAD, que por defecto no está en ningún lado: el ejemplo de COMBOS la pone
+// en F11+F12, o se asigna en LAYER_KEYMAPS.
+struct LeaderSequence {
+  uint8_t keys[MAX_COMBO_LENGTH];
+  LayerKey action;
+};
+
+constexpr LeaderSequence LEADER_SEQUENCES[] = {
+  {{KEY_F1}, KC(KEY_ESC)},
+  {{KEY_F1, KEY_F2}, TG(1)},
+  {{KEY_F1, KEY_F2, KEY_F3}, TG(2)},
+  {{'a', 'b'}, MPLAY(0)},
+  {{'a', 'c'}, MREC(0)},
+};
+
+constexpr LayerKey LAYER_KEYMAPS[LAYER_COUNT][16] = {
+  // 0: perfil activo
+  {____, ____, ____, TD_EXAMPLE(0), TD_EXAMPLE(1), TD_EXAMPLE(2), ____, ____,
+   ____, ____, ____, ____, ____, ____, ____, ____},
+  // 1: números (los botones 13-16 quedan libres para teclas de capa)
+  {KC('1'), KC('2'), KC('3'), KC('4'), KC('5'), KC('6'), KC('7'), KC('8'),
+   KC('9'), KC('0'), KC('-'), KC('='), ____, ____, ____, ____},
+  // 2: edición y navegación
+  {KC(KEY_ESC), KC(KEY_TAB), KC(KEY_RETURN), KC(KEY_BACKSPACE),
+   KC(KEY_HOME), KC(KEY_END), KC(KEY_PAGE_UP), KC(KEY_PAGE_DOWN),
+   ____, ____, ____, ____, ____, ____, ____, ____}
+};
+
+// Encoders por capa: {izq, der}; LAYER_ENCODER_TRANSPARENT usa la de abajo
+#define LAYER_ENCODER_TRANSPARENT 0
+constexpr uint8_t LAYER_ENCODERS[LAYER_COUNT][2][2] = {
+  {{LAYER_ENCODER_TRANSPARENT, LAYER_ENCODER_TRANSPARENT}, {LAYER_ENCODER_TRANSPARENT, LAYER_ENCODER_TRANSPARENT}},
+  {{KEY_LEFT_ARROW, KEY_RIGHT_ARROW}, {KEY_UP_ARROW, KEY_DOWN_ARROW}},
+  {{LAYER_ENCODER_TRANSPARENT, LAYER_ENCODER_TRANSPARENT}, {KEY_PAGE_UP, KEY_PAGE_DOWN}}
+};
+
+// ============= MACROS =============
+#define MACRO_SLOTS 4
+#define MACRO_POOL_SIZE 252         // Bytecode de todas las macros juntas
+#define MACRO_RECORD_MAX 128        // Largo máximo de una macro grabada
+#define MACRO_MIN_WAIT_MS 250       // Pausas más cortas no se graban: se
+                                    // reproduce lo tipeado, no el ritmo
+#define MACRO_MAX_HELD 6            // Teclas mantenidas a la vez en una macro
+#define MACRO_TASK_PERIOD_US 0      // Cada pasada: avanza al ritmo del host
+
 // ============= ARRAYS DE TECLAS DISPONIBLES =============
-const uint8_t AVAILABLE_LETTERS[] = {
+constexpr uint8_t AVAILABLE_LETTERS[] = {
   'a','b','c','d','e','f','g','h','i','j','k','l','m',
   'n','o','p','q','r','s','t','u','v','w','x','y','z'
 };
 
-const uint8_t AVAILABLE_NUMBERS[] = {
+constexpr uint8_t AVAILABLE_NUMBERS[] = {
   '0','1','2','3','4','5','6','7','8','9'
 };
 
-const uint8_t AVAILABLE_FUNCTIONS[] = {
+constexpr uint8_t AVAILABLE_FUNCTIONS[] = {
   KEY_F1, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6,
   KEY_F7, KEY_F8, KEY_F9, KEY_F10, KEY_F11, KEY_F12
 };
 
-const uint8_t AVAILABLE_SPECIAL[] = {
+constexpr uint8_t AVAILABLE_SPECIAL[] = {
   ' ', KEY_RETURN, KEY_TAB, KEY_ESC, KEY_BACKSPACE,
   KEY_LEFT_ARROW, KEY_RIGHT_ARROW, KEY_UP_ARROW, KEY_DOWN_ARROW
 };
 
-const uint8_t AVAILABLE_SYMBOLS[] = {
+constexpr uint8_t AVAILABLE_SYMBOLS[] = {
   '!','@','#','$','%','^','&','*','(',')','-','=',
   '[',']','{','}','\\','|',';','\'',',','.','/'
 };
@@ -139,24 +380,18 @@ enum KeyPriority {
   PRIORITY_LOW = 9
 };
 
-uint8_t getKeyPriority(uint8_t keycode) {
-  if(keycode >= KEY_F1 && keycode <= KEY_F12) {
-    return PRIORITY_HIGH;
-  }
-  if(keycode == KEY_ESC || keycode == KEY_RETURN) {
-    return PRIORITY_HIGH;
-  }
-  if((keycode >= 'a' && keycode <= 'z') ||
-    (keycode >= '0' && keycode <= '9')) {
-    return PRIORITY_NORMAL;
-    }
-    return PRIORITY_LOW;
-}
+// La prioridad de cada tecla está en la tabla de keycodes.h (keyPriority)
 
 // ============= VALIDACIÓN Y DEBUG =============
 #define DEBUG_MODE true
 #define SERIAL_BAUD 115200
 
+// Perfilado por zonas con el contador de ciclos DWT (profile.h). Con false
+// las macros PROFILE_ZONE() no generan código
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED false
+#endif
+
 #if DEBUG_MODE
 #define DEBUG_PRINT(x) Serial.print(x)
 #define DEBUG_PRINTLN(x) Serial.println(x)
@@ -174,6 +409,7 @@ struct SystemStats {
   unsigned long i2cErrors;
   unsigned long bufferOverflows;
   unsigned long longestLoopTime;
+  unsigned long i2cTransactions;
 };
 
 extern SystemStats systemStats;
@@ -3,31 +3,145 @@
 
 #include "config.h"
 #include "storage.h"
-#include <Keyboard.h>
+#include "keycodes.h"
+#include "buffer.h"
 
 // ============= CONSTANTES DE CONFIGURACIÓN =============
 #define CONFIG_ENTRY_HOLD_TIME 3000
 #define CONFIG_TIMEOUT 10000
 #define CONFIG_KEY1 0
 #define CONFIG_KEY2 11
+#define CONFIG_ENTRY_MASK ((1 << CONFIG_KEY1) | (1 << CONFIG_KEY2))
+
+// ============= RENDERIZADOR DE TEXTO NO BLOQUEANTE =============
+// El modo configuración "escribe" en el editor del host. En vez de
+// Keyboard.write() + delay(), el texto entra a una cola propia y update()
+// lo pasa al buffer de teclas de a poco, así que lo envía el KeyTransmitter
+// mientras el escaneo sigue corriendo.
+//
+// setLine() mantiene una línea editable: solo se encolan los backspaces y
+// caracteres que difieren de lo ya escrito. Las ediciones que aún no
+// salieron se descartan y se recalculan, así que girar rápido un encoder
+// converge al último texto sin escribir los intermedios.
+class ConfigRenderer {
+private:
+  static const uint16_t MASK = CONFIG_OUTPUT_QUEUE_SIZE - 1;
+  static_assert((CONFIG_OUTPUT_QUEUE_SIZE & MASK) == 0, "Tamaño potencia de 2");
+
+  PriorityKeyBuffer* output;
+  uint8_t queue[CONFIG_OUTPUT_QUEUE_SIZE];
+  uint16_t head;            // Próxima tecla a enviar (free-running)
+  uint16_t tail;            // Próximo lugar libre (free-running)
+
+  // Línea editable
+  bool lineActive;
+  uint16_t lineStart;       // Posición de la cola donde empiezan sus ediciones
+  char lineSent[CONFIG_LINE_MAX];
+  uint8_t lineSentLength;   // Lo que ya se escribió de la línea en el host
+
+  // Estadísticas
+  unsigned long keysSent;
+  unsigned long keysSaved;  // Ediciones descartadas o evitadas por el diff
+
+  void enqueue(uint8_t keycode) {
+    if((uint16_t)(tail - head) >= CONFIG_OUTPUT_QUEUE_SIZE) return;
+    queue[tail & MASK] = keycode;
+    tail++;
+  }
 
-// ============= TECLAS DISPONIBLES PARA REMAPEO =============
-const uint8_t ENCODER_A_OPTIONS[] = {
-  'a','b','c','d','e','f','g','h','i','j','k','l','m',
-  'n','o','p','q','r','s','t','u','v','w','x','y','z',
-  '0','1','2','3','4','5','6','7','8','9',
-  ' ', KEY_RETURN, KEY_TAB, KEY_ESC, KEY_BACKSPACE
-};
-const uint8_t ENCODER_A_COUNT = sizeof(ENCODER_A_OPTIONS);
-
-const uint8_t ENCODER_B_OPTIONS[] = {
-  KEY_F1, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6,
-  KEY_F7, KEY_F8, KEY_F9, KEY_F10, KEY_F11, KEY_F12,
-  '!','@','#','$','%','^','&','*','(',')','-','=',
-  '[',']','{','}','\\','|',';','\'',',','.','/',
-  KEY_LEFT_ARROW, KEY_RIGHT_ARROW, KEY_UP_ARROW, KEY_DOWN_ARROW
+  // Solo ASCII: los bytes UTF-8 no tienen tecla en la distribución US
+  void enqueueText(const char* text) {
+    for(; *text; text++) {
+      uint8_t c = *text;
+      if(c == '\n') {
+        enqueue(KEY_RETURN);
+      } else if(c >= ' ' && c < 0x7F) {
+        enqueue(c);
+      }
+    }
+  }
+
+public:
+  ConfigRenderer(PriorityKeyBuffer* buffer) :
+    output(buffer),
+    head(0),
+    tail(0),
+    lineActive(false),
+    lineStart(0),
+    lineSentLength(0),
+    keysSent(0),
+    keysSaved(0) {}
+
+  // Texto fijo; cierra la línea editable si la había
+  void print(const char* text) {
+    lineActive = false;
+    enqueueText(text);
+  }
+
+  void println(const char* text) {
+    print(text);
+    enqueue(KEY_RETURN);
+  }
+
+  // Reemplazar el contenido de la línea editable por text
+  void setLine(const char* text) {
+    if(!lineActive) {
+      lineActive = true;
+      lineStart = tail;
+      lineSentLength = 0;
+    } else {
+      // Descartar las ediciones de la línea que todavía no salieron
+      uint16_t keep = ((int16_t)(head - lineStart) > 0) ? head : lineStart;
+      keysSaved += (uint16_t)(tail - keep);
+      tail = keep;
+      lineStart = keep;
+    }
+
+    uint8_t common = 0;
+    while(common < lineSentLength && text[common] && lineSent[common] == text[common]) {
+      common++;
+    }
+    keysSaved += common;
+
+    for(uint8_t i = common; i < lineSentLength; i++) {
+      enqueue(KEY_BACKSPACE);
+    }
+    for(uint8_t i = common; text[i] && i < CONFIG_LINE_MAX; i++) {
+      if(text[i] >= ' ' && text[i] < 0x7F) enqueue(text[i]);
+    }
+  }
+
+  // Pasar texto al buffer de teclas sin llenarlo; llamar en cada pasada
+  void update() {
+    while(head != tail && output->getCount() < CONFIG_OUTPUT_MAX_PENDING) {
+      uint8_t keycode = queue[head & MASK];
+
+      // Una sola prioridad para que el texto salga en orden
+      if(!output->push(keycode, PRIORITY_NORMAL)) break;
+
+      if(lineActive && (int16_t)(head - lineStart) >= 0) {
+        if(keycode == KEY_BACKSPACE) {
+          if(lineSentLength > 0) lineSentLength--;
+        } else if(lineSentLength < CONFIG_LINE_MAX) {
+          lineSent[lineSentLength++] = keycode;
+        }
+      }
+
+      head++;
+      keysSent++;
+    }
+  }
+
+  bool isBusy() {
+    return head != tail;
+  }
+
+  void getStats(unsigned long* sent, unsigned long* saved, uint16_t* pending) {
+    *sent = keysSent;
+    *saved = keysSaved;
+    *pending = tail - head;
+  }
 };
-const uint8_t ENCODER_B_COUNT = sizeof(ENCODER_B_OPTIONS);
 
 // ============= CLASE MODO CONFIGURACIÓN =============
 class ConfigMode {
@@ -52,62 +166,11 @@ private:
   uint8_t currentSelection;
   bool usingEncoderB;
 
-  // Escribir texto en el editor activo
-  void typeText(const char* text) {
-    while(*text) {
-      Keyboard.write(*text);
-      delay(10);
-      text++;
-    }
-  }
-
-  // Escribir nueva línea
-  void typeNewline() {
-    Keyboard.write(KEY_RETURN);
-    delay(10);
-  }
-
-  // Borrar línea anterior
-  void clearLine() {
-    for(int i = 0; i < 50; i++) {
-      Keyboard.write(KEY_BACKSPACE);
-      delay(5);
-    }
-  }
-
-  // Obtener nombre de tecla para mostrar
-  void getKeyName(uint8_t keycode, char* buffer) {
-    if(keycode >= 'a' && keycode <= 'z') {
-      sprintf(buffer, "%c", keycode);
-    } else if(keycode >= '0' && keycode <= '9') {
-      sprintf(buffer, "%c", keycode);
-    } else if(keycode == ' ') {
-      sprintf(buffer, "SPACE");
-    } else if(keycode == KEY_RETURN) {
-      sprintf(buffer, "ENTER");
-    } else if(keycode == KEY_TAB) {
-      sprintf(buffer, "TAB");
-    } else if(keycode == KEY_ESC) {
-      sprintf(buffer, "ESC");
-    } else if(keycode == KEY_BACKSPACE) {
-      sprintf(buffer, "BACKSPACE");
-    } else if(keycode >= KEY_F1 && keycode <= KEY_F12) {
-      sprintf(buffer, "F%d", (keycode - KEY_F1) + 1);
-    } else if(keycode == KEY_LEFT_ARROW) {
-      sprintf(buffer, "LEFT");
-    } else if(keycode == KEY_RIGHT_ARROW) {
-      sprintf(buffer, "RIGHT");
-    } else if(keycode == KEY_UP_ARROW) {
-      sprintf(buffer, "UP");
-    } else if(keycode == KEY_DOWN_ARROW) {
-      sprintf(buffer, "DOWN");
-    } else {
-      sprintf(buffer, "%c", keycode);
-    }
-  }
+  // Salida de texto hacia el editor activo
+  ConfigRenderer renderer;
 
 public:
-  ConfigMode() {
+  ConfigMode(PriorityKeyBuffer* output) : renderer(output) {
     currentState = IDLE;
     selectedButton = -1;
     encoderAIndex = 0;
@@ -117,10 +180,11 @@ public:
     usingEncoderB = false;
   }
 
-  bool checkEntry(bool* buttonStates) {
+  // pressedMask: estado debounced, bit n = botón n
+  bool checkEntry(uint16_t pressedMask) {
     if(currentState != IDLE && currentState != CHECKING_ENTRY) return false;
 
-    bool keysPressed = buttonStates[CONFIG_KEY1] && buttonStates[CONFIG_KEY2];
+    bool keysPressed = (pressedMask & CONFIG_ENTRY_MASK) == CONFIG_ENTRY_MASK;
 
     if(keysPressed && !configKeysPressed) {
       configKeysPressed = true;
@@ -144,11 +208,9 @@ public:
     stateStartTime = millis();
     selectedButton = -1;
 
-    typeNewline();
-    typeText("=== CONFIGURANDO TECLADO ===");
-    typeNewline();
-    typeText("Presione la tecla a configurar...");
-    typeNewline();
+    renderer.print("\n");
+    renderer.println("=== CONFIGURANDO TECLADO ===");
+    renderer.println("Presione la tecla a configurar...");
   }
 
   void processButton(int8_t buttonIndex) {
@@ -158,106 +220,88 @@ public:
       stateStartTime = millis();
 
       uint8_t currentKey = BUTTON_MAP[buttonIndex].keycode;
+      const KeyInfo& info = keyInfo(currentKey);
       encoderAIndex = -1;
       encoderBIndex = -1;
+      currentSelection = currentKey;
 
-      for(int i = 0; i < ENCODER_A_COUNT; i++) {
-        if(ENCODER_A_OPTIONS[i] == currentKey) {
-          encoderAIndex = i;
-          currentSelection = currentKey;
-          usingEncoderB = false;
-          break;
-        }
-      }
-
-      if(encoderAIndex == -1) {
-        for(int i = 0; i < ENCODER_B_COUNT; i++) {
-          if(ENCODER_B_OPTIONS[i] == currentKey) {
-            encoderBIndex = i;
-            currentSelection = currentKey;
-            usingEncoderB = true;
-            break;
-          }
-        }
-      }
-
-      if(encoderAIndex == -1 && encoderBIndex == -1) {
+      if(info.optionList == KEY_OPTIONS_A) {
+        encoderAIndex = info.optionIndex;
+        usingEncoderB = false;
+      } else if(info.optionList == KEY_OPTIONS_B) {
+        encoderBIndex = info.optionIndex;
+        usingEncoderB = true;
+      } else {
         encoderAIndex = 0;
         currentSelection = ENCODER_A_OPTIONS[0];
         usingEncoderB = false;
       }
 
-      char keyName[20];
-      getKeyName(currentKey, keyName);
       char buffer[100];
       sprintf(buffer, "Configurando boton %d. Mapeo actual: [%s]",
-              buttonIndex + 1, keyName);
-      typeText(buffer);
-      typeNewline();
-      typeText("Gire encoder A para letras/numeros, B para simbolos/F");
-      typeNewline();
+              buttonIndex + 1, keyName(currentKey));
+      renderer.println(buffer);
+      renderer.println("Gire encoder A para letras/numeros, B para simbolos/F");
 
     } else if(currentState == SELECTING_NEW_MAP && buttonIndex == selectedButton) {
       confirmMapping();
     }
   }
 
-  void processEncoder(uint8_t encoderNum, int8_t direction) {
+  // steps: pasos acelerados con signo; un giro rápido recorre varias opciones
+  void processEncoder(uint8_t encoderNum, int16_t steps) {
     if(currentState == SELECTING_NEW_MAP) {
-      char keyName[20];
-
       if(encoderNum == 0) {
-        encoderAIndex += direction;
-        if(encoderAIndex < 0) encoderAIndex = ENCODER_A_COUNT - 1;
-        if(encoderAIndex >= ENCODER_A_COUNT) encoderAIndex = 0;
-
+        encoderAIndex = stepIndex(encoderAIndex, steps, ENCODER_A_COUNT);
         currentSelection = ENCODER_A_OPTIONS[encoderAIndex];
         usingEncoderB = false;
 
       } else {
-        encoderBIndex += direction;
-        if(encoderBIndex < 0) encoderBIndex = ENCODER_B_COUNT - 1;
-        if(encoderBIndex >= ENCODER_B_COUNT) encoderBIndex = 0;
-
+        encoderBIndex = stepIndex(encoderBIndex, steps, ENCODER_B_COUNT);
         currentSelection = ENCODER_B_OPTIONS[encoderBIndex];
         usingEncoderB = true;
       }
 
-      clearLine();
-      getKeyName(currentSelection, keyName);
-      char buffer[50];
-      sprintf(buffer, "Nuevo mapeo: [%s]", keyName);
-      typeText(buffer);
+      // Solo se reescribe lo que cambió respecto de la vista previa anterior
+      char buffer[CONFIG_LINE_MAX];
+      snprintf(buffer, sizeof(buffer), "Nuevo mapeo: [%s]", keyName(currentSelection));
+      renderer.setLine(buffer);
 
     } else if(currentState == WAITING_NEXT_ACTION) {
       exitConfigMode();
     }
   }
 
+  // Avanzar un índice de opciones con vuelta al principio; -1 (tecla sin
+  // opción en la lista) retrocede a la última
+  static int8_t stepIndex(int8_t index, int16_t steps, uint8_t count) {
+    if(index < 0 && steps < 0) index = 0;
+    int16_t next = (index + steps) % count;
+    if(next < 0) next += count;
+    return next;
+  }
+
   void confirmMapping() {
     BUTTON_MAP[selectedButton].keycode = currentSelection;
-    saveConfiguration();
-
-    char keyName[20];
-    getKeyName(currentSelection, keyName);
+    markMappingChanged();
+    scheduleConfigurationSave();
 
-    typeNewline();
+    renderer.print("\n");
     char buffer[50];
-    sprintf(buffer, "✓ Boton %d configurado como [%s]",
-            selectedButton + 1, keyName);
-    typeText(buffer);
-    typeNewline();
-    typeText("¿Configurar otra tecla? Presionela para comenzar o gire encoder para salir");
-    typeNewline();
+    sprintf(buffer, "OK Boton %d configurado como [%s]",
+            selectedButton + 1, keyName(currentSelection));
+    renderer.println(buffer);
+    renderer.println("Configurar otra tecla? Presionela para comenzar o gire encoder para salir");
 
     currentState = WAITING_NEXT_ACTION;
     stateStartTime = millis();
   }
 
   void exitConfigMode() {
-    typeText("=== CONFIGURACION GUARDADA ===");
-    typeNewline();
-    typeNewline();
+    flushConfiguration();
+
+    renderer.println("=== CONFIGURACION GUARDADA ===");
+    renderer.print("\n");
 
     currentState = IDLE;
     selectedButton = -1;
@@ -266,15 +310,27 @@ public:
   void checkTimeout() {
     if(currentState != IDLE && currentState != CHECKING_ENTRY) {
       if(millis() - stateStartTime >= CONFIG_TIMEOUT) {
-        typeNewline();
-        typeText("Timeout - Saliendo del modo configuracion");
+        renderer.print("\n");
+        renderer.println("Timeout - Saliendo del modo configuracion");
         exitConfigMode();
       }
     }
   }
 
+  // Llamar en cada pasada: envía texto pendiente y revisa el timeout
+  void update() {
+    renderer.update();
+    checkTimeout();
+  }
+
+  // Sigue activo mientras quede texto por escribir, para que las teclas
+  // normales no se mezclen con el final de los mensajes
   bool isActive() {
-    return currentState != IDLE;
+    return currentState != IDLE || renderer.isBusy();
+  }
+
+  void getRendererStats(unsigned long* sent, unsigned long* saved, uint16_t* pending) {
+    renderer.getStats(sent, saved, pending);
   }
 
   State getState() {
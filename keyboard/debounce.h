@@ -3,120 +3,212 @@
 
 #include "config.h"
 
-// ============= DEBOUNCE SIMPLE BASE =============
-class SimpleDebounce {
-protected:
-  unsigned long lastTime;
-  bool lastState;
-  unsigned long debounceDelay;
-  
+// ============= CONTADOR VERTICAL (BIT-PARALELO) =============
+// Un contador por entrada, guardado "en vertical": el plano k contiene el
+// bit k del contador de todas las entradas, así que cada operación afecta a
+// las 8/16/32 entradas de T con unas pocas instrucciones. El número de
+// planos se calcula en compilación a partir del valor máximo que necesita
+// la política elegida.
+constexpr uint8_t counterPlanes(uint8_t maxValue) {
+  return maxValue < 2 ? 1 : 1 + counterPlanes(maxValue >> 1);
+}
+
+template<typename T, uint8_t PLANES>
+class VerticalCounter {
+private:
+  T plane[PLANES];
+
 public:
-  SimpleDebounce(unsigned long delay = BUTTON_DEBOUNCE_DELAY) 
-    : lastTime(0), lastState(false), debounceDelay(delay) {}
-  
-  bool update(bool currentState) {
-    unsigned long currentTime = millis();
-    
-    if (currentState != lastState) {
-      if (currentTime - lastTime >= debounceDelay) {
-        lastTime = currentTime;
-        lastState = currentState;
-        return true; // Estado cambió de forma estable
-      }
+  VerticalCounter() {
+    for(uint8_t k = 0; k < PLANES; k++) plane[k] = 0;
+  }
+
+  T nonZero() {
+    T nz = 0;
+    for(uint8_t k = 0; k < PLANES; k++) nz |= plane[k];
+    return nz;
+  }
+
+  T equals(uint8_t value) {
+    T eq = (T)~(T)0;
+    for(uint8_t k = 0; k < PLANES; k++) {
+      eq &= ((value >> k) & 1) ? plane[k] : (T)~plane[k];
     }
-    return false; // No hay cambio estable
+    return eq;
   }
-  
-  bool getState() { return lastState; }
-  
-  void setDelay(unsigned long delay) { debounceDelay = delay; }
-};
 
-// ============= DEBOUNCE SOFISTICADO BASE =============
-class AdvancedDebounce {
-protected:
-  bool samples[DEBOUNCE_SAMPLES];
-  uint8_t index;
-  bool stableState;
-  unsigned long lastSampleTime;
-  unsigned long sampleInterval;
-  
-public:
-  AdvancedDebounce(unsigned long interval = 5) 
-    : index(0), stableState(false), lastSampleTime(0), sampleInterval(interval) {
-    for(int i = 0; i < DEBOUNCE_SAMPLES; i++) {
-      samples[i] = false;
+  // Restar 1 a los contadores no nulos de mask (préstamo plano a plano)
+  void decrement(T mask) {
+    T borrow = mask & nonZero();
+    for(uint8_t k = 0; k < PLANES; k++) {
+      T c = plane[k];
+      plane[k] = c ^ borrow;
+      borrow &= ~c;
     }
   }
-  
-  bool update(bool currentState) {
-    unsigned long currentTime = millis();
-    
-    // Solo tomar muestra si pasó el intervalo
-    if(currentTime - lastSampleTime < sampleInterval) {
-      return false;
+
+  // Sumar 1 a los contadores de mask (acarreo plano a plano)
+  void increment(T mask) {
+    T carry = mask;
+    for(uint8_t k = 0; k < PLANES; k++) {
+      T c = plane[k];
+      plane[k] = c ^ carry;
+      carry &= c;
     }
-    lastSampleTime = currentTime;
-    
-    samples[index] = currentState;
-    index = (index + 1) % DEBOUNCE_SAMPLES;
-    
-    // Verificar si todas las muestras son iguales
-    bool allSame = true;
-    bool firstSample = samples[0];
-    
-    for(int i = 1; i < DEBOUNCE_SAMPLES; i++) {
-      if(samples[i] != firstSample) {
-        allSame = false;
-        break;
-      }
+  }
+
+  void load(T mask, uint8_t value) {
+    for(uint8_t k = 0; k < PLANES; k++) {
+      plane[k] = (plane[k] & ~mask) | (((value >> k) & 1) ? mask : 0);
     }
-    
-    if(allSame && firstSample != stableState) {
-      stableState = firstSample;
-      return true; // Estado cambió de forma estable
+  }
+};
+
+// ============= POLÍTICAS DE DEBOUNCE =============
+// Cada política es un tipo con sus tiempos como parámetros de plantilla:
+// MAX_COUNT fija el tamaño del contador y step() devuelve la máscara de
+// entradas cuyo cambio se acepta en esta muestra. Las cuentas son de ticks
+// de MAIN_LOOP_INTERVAL, no de lecturas: una lectura extra dentro del mismo
+// tick (elapsedTicks = 0, p. ej. por la INT del PCF8575) no acorta la
+// ventana. Solo se compila la política que se instancia.
+
+// Eager: el primer flanco se acepta al instante y la entrada queda
+// bloqueada LOCKOUT ticks. Mínima latencia; un glitch aislado pasa
+template<uint8_t LOCKOUT>
+struct EagerDebounce {
+  static const uint8_t MAX_COUNT = LOCKOUT;
+  static const char* name() { return "eager"; }
+
+  template<typename T, typename Counter>
+  static T step(Counter& count, T raw, T state, uint8_t elapsedTicks) {
+    // Contador = ticks de bloqueo restantes tras el último cambio aceptado
+    for(uint8_t i = 0; i < elapsedTicks && i < LOCKOUT; i++) {
+      count.decrement((T)~(T)0);
     }
-    
-    return false; // No hay cambio estable
+    T accepted = (raw ^ state) & ~count.nonZero();
+    count.load(accepted, LOCKOUT);
+    return accepted;
   }
-  
-  bool getState() { return stableState; }
-  
-  void setSampleInterval(unsigned long interval) { sampleInterval = interval; }
 };
 
-// ============= DEBOUNCE PARA BOTONES =============
-class ButtonDebounce {
-private:
-  SimpleDebounce simple;
-  AdvancedDebounce advanced;
-  bool useSimple;
-  
-public:
-  ButtonDebounce() : 
-    simple(BUTTON_DEBOUNCE_DELAY), 
-    advanced(BUTTON_DEBOUNCE_DELAY / DEBOUNCE_SAMPLES),
-    useSimple(DEBOUNCE_SIMPLE) {}
-  
-  bool update(bool currentState) {
-    if(useSimple) {
-      return simple.update(currentState);
-    } else {
-      return advanced.update(currentState);
+// Ventana: el cambio se acepta tras SAMPLES ticks seguidos distintos del
+// estado estable; cualquier muestra igual reinicia la cuenta
+template<uint8_t SAMPLES>
+struct WindowDebounce {
+  static const uint8_t MAX_COUNT = SAMPLES;
+  static const char* name() { return "ventana"; }
+
+  template<typename T, typename Counter>
+  static T step(Counter& count, T raw, T state, uint8_t elapsedTicks) {
+    T diff = raw ^ state;
+    count.load((T)~diff, 0);
+
+    // La primera muestra distinta cuenta un tick; las siguientes, los
+    // ticks transcurridos desde la anterior
+    T running = diff & count.nonZero();
+    count.increment(diff & ~running);
+    for(uint8_t i = 0; i < elapsedTicks && i < SAMPLES; i++) {
+      count.increment(running & ~count.equals(SAMPLES));
     }
+
+    T accepted = diff & count.equals(SAMPLES);
+    count.load(accepted, 0);
+    return accepted;
   }
-  
-  bool getState() {
-    if(useSimple) {
-      return simple.getState();
-    } else {
-      return advanced.getState();
+};
+
+// Integrador: sube por cada tick activo y baja por cada inactivo,
+// saturando en 0 y SAMPLES; el estado cambia al llegar a un extremo.
+// Los rebotes retrasan el cambio en vez de reiniciarlo
+template<uint8_t SAMPLES>
+struct IntegratingDebounce {
+  static const uint8_t MAX_COUNT = SAMPLES;
+  static const char* name() { return "integrador"; }
+
+  template<typename T, typename Counter>
+  static T step(Counter& count, T raw, T state, uint8_t elapsedTicks) {
+    // Saliendo del extremo del estado estable la muestra cuenta un tick
+    // (el cambio pudo llegar al final del hueco); dentro, los transcurridos
+    T leaving = (raw & ~state & ~count.nonZero()) |
+                ((T)~raw & state & count.equals(SAMPLES));
+    count.increment(raw & leaving);
+    count.decrement((T)~raw & leaving);
+    for(uint8_t i = 0; i < elapsedTicks && i < SAMPLES; i++) {
+      count.increment(raw & ~leaving & ~count.equals(SAMPLES));
+      count.decrement((T)~raw & ~leaving);
     }
+    return (~state & count.equals(SAMPLES)) | (state & ~count.nonZero());
   }
-  
-  void setMode(bool simpleMode) {
-    useSimple = simpleMode;
+};
+
+// Asimétrica: como la ventana, con umbrales distintos para presionar y
+// soltar (p. ej. presión inmediata y liberación filtrada)
+template<uint8_t PRESS_SAMPLES, uint8_t RELEASE_SAMPLES>
+struct AsymmetricDebounce {
+  static const uint8_t MAX_COUNT =
+    PRESS_SAMPLES > RELEASE_SAMPLES ? PRESS_SAMPLES : RELEASE_SAMPLES;
+  static const char* name() { return "asimetrica"; }
+
+  template<typename T, typename Counter>
+  static T step(Counter& count, T raw, T state, uint8_t elapsedTicks) {
+    T diff = raw ^ state;
+    count.load((T)~diff, 0);
+
+    // Ticks como en la ventana, saturando en el umbral de cada sentido
+    T running = diff & count.nonZero();
+    count.increment(diff & ~running);
+    for(uint8_t i = 0; i < elapsedTicks && i < MAX_COUNT; i++) {
+      count.increment(running & ~((~state & count.equals(PRESS_SAMPLES)) |
+                                  (state & count.equals(RELEASE_SAMPLES))));
+    }
+
+    T accepted = diff & ((~state & count.equals(PRESS_SAMPLES)) |
+                         (state & count.equals(RELEASE_SAMPLES)));
+    count.load(accepted, 0);
+    return accepted;
+  }
+};
+
+#if BUTTON_DEBOUNCE_POLICY == DEBOUNCE_EAGER
+typedef EagerDebounce<BUTTON_DEBOUNCE_TICKS> ButtonDebouncePolicy;
+#elif BUTTON_DEBOUNCE_POLICY == DEBOUNCE_WINDOW
+typedef WindowDebounce<DEBOUNCE_SAMPLES> ButtonDebouncePolicy;
+#elif BUTTON_DEBOUNCE_POLICY == DEBOUNCE_INTEGRATING
+typedef IntegratingDebounce<DEBOUNCE_SAMPLES> ButtonDebouncePolicy;
+#elif BUTTON_DEBOUNCE_POLICY == DEBOUNCE_ASYMMETRIC
+typedef AsymmetricDebounce<DEBOUNCE_PRESS_SAMPLES, DEBOUNCE_RELEASE_SAMPLES> ButtonDebouncePolicy;
+#else
+#error "BUTTON_DEBOUNCE_POLICY desconocida"
+#endif
+
+// ============= DEBOUNCE VERTICAL =============
+// Filtro de hasta 8/16/32 entradas con la política Policy
+template<typename T, typename Policy>
+class VerticalDebounce {
+private:
+  VerticalCounter<T, counterPlanes(Policy::MAX_COUNT)> count;
+  T state;
+  T pressed;
+  T released;
+
+public:
+  VerticalDebounce() : state(0), pressed(0), released(0) {}
+
+  // raw: bit = 1 entrada activa; elapsedTicks: ticks desde la llamada anterior
+  bool update(T raw, uint8_t elapsedTicks) {
+    T accepted = Policy::step(count, raw, state, elapsedTicks);
+
+    state ^= accepted;
+    pressed = accepted & state;
+    released = accepted & ~state;
+    return accepted != 0;
   }
+
+  T getState() { return state; }
+
+  // Flancos de la última actualización; cada uno aparece una sola vez
+  T getPressed() { return pressed; }
+  T getReleased() { return released; }
 };
 
 // ============= DEBOUNCE ESPECIALIZADO PARA ENCODERS =============
@@ -178,184 +270,94 @@ public:
   bool getPinB() { return stableState & 1; }
 };
 
-// ============= DEBOUNCE CON ESTADÍSTICAS =============
-class DebouncedButton {
+// ============= DEBOUNCE GRUPAL =============
+// Los 16 botones del PCF8575 en un solo VerticalDebounce con la política de
+// BUTTON_DEBOUNCE_POLICY. Los llamadores
+// recorren las máscaras de flancos con __builtin_ctz:
+//   while(mask) { uint8_t i = __builtin_ctz(mask); mask &= mask - 1; ... }
+class GroupDebounce {
 private:
-  ButtonDebounce debouncer;
-  bool lastStableState;
-  
+  static const uint8_t MAX_BUTTONS = 16;
+
+  VerticalDebounce<uint16_t, ButtonDebouncePolicy> filter;
+  unsigned long lastTick;
+  uint16_t lastRaw;
+  unsigned long pressTime[MAX_BUTTONS];
+
   // Estadísticas
   unsigned long pressCount;
-  unsigned long releaseCount;
-  unsigned long lastPressTime;
-  unsigned long lastReleaseTime;
-  unsigned long longestPress;
-  unsigned long shortestPress;
   unsigned long bounceCount;
-  
+
 public:
-  DebouncedButton() : 
-    lastStableState(false),
+  GroupDebounce() :
+    lastTick(0),
+    lastRaw(0),
     pressCount(0),
-    releaseCount(0),
-    lastPressTime(0),
-    lastReleaseTime(0),
-    longestPress(0),
-    shortestPress(0xFFFFFFFF),
-    bounceCount(0) {}
-  
-  bool update(bool currentRawState) {
-    bool changed = debouncer.update(currentRawState);
-    
-    if(changed) {
-      bool newState = debouncer.getState();
-      
-      if(newState && !lastStableState) {
-        // Transición a presionado
-        pressCount++;
-        lastPressTime = millis();
-        
-      } else if(!newState && lastStableState) {
-        // Transición a liberado
-        releaseCount++;
-        lastReleaseTime = millis();
-        
-        // Calcular duración de la pulsación
-        if(lastPressTime > 0) {
-          unsigned long duration = lastReleaseTime - lastPressTime;
-          if(duration > longestPress) longestPress = duration;
-          if(duration < shortestPress) shortestPress = duration;
-        }
-      }
-      
-      lastStableState = newState;
-      return true;
-    }
-    
-    // Detectar rebotes (cambios en raw sin cambio en estable)
-    static bool lastRawState = false;
-    if(currentRawState != lastRawState) {
-      bounceCount++;
-      lastRawState = currentRawState;
+    bounceCount(0) {
+    for(uint8_t i = 0; i < MAX_BUTTONS; i++) {
+      pressTime[i] = 0;
     }
-    
-    return false;
-  }
-  
-  bool isPressed() { return lastStableState; }
-  
-  bool wasPressed() {
-    return lastStableState && (millis() - lastPressTime < 50);
   }
-  
-  bool wasReleased() {
-    return !lastStableState && (millis() - lastReleaseTime < 50);
-  }
-  
-  // Detección de patrones
-  bool isLongPress(unsigned long threshold = 1000) {
-    if(!lastStableState) return false;
-    return (millis() - lastPressTime) >= threshold;
-  }
-  
-  bool isDoubleClick(unsigned long maxInterval = 500) {
-    if(pressCount < 2) return false;
-    
-    // Verificar si hubo 2 pulsaciones recientes
-    static unsigned long lastDoubleCheckTime = 0;
-    static uint8_t lastPressCountCheck = 0;
-    
-    if(pressCount > lastPressCountCheck) {
-      if(millis() - lastDoubleCheckTime < maxInterval) {
-        lastPressCountCheck = pressCount;
-        return true;
-      }
-      lastDoubleCheckTime = millis();
-      lastPressCountCheck = pressCount;
+
+  // Actualizar todos los botones de una vez (bit = 1 presionado)
+  bool updateAll(uint16_t rawState) {
+    unsigned long now = millis();
+    unsigned long ticks = (now - lastTick) / MAIN_LOOP_INTERVAL;
+    lastTick += ticks * MAIN_LOOP_INTERVAL;
+
+    bool changed = filter.update(rawState, ticks > 255 ? 255 : ticks);
+
+    // Rebotes: cambios crudos que el filtro no aceptó
+    uint16_t edges = filter.getPressed() | filter.getReleased();
+    bounceCount += __builtin_popcount((rawState ^ lastRaw) & ~edges);
+    lastRaw = rawState;
+
+    uint16_t presses = filter.getPressed();
+    while(presses) {
+      uint8_t i = __builtin_ctz(presses);
+      presses &= presses - 1;
+      pressTime[i] = now;
+      pressCount++;
     }
-    
-    return false;
-  }
-  
-  // Obtener estadísticas
-  void getStats(unsigned long* presses, unsigned long* bounces, unsigned long* longest) {
-    *presses = pressCount;
-    *bounces = bounceCount;
-    *longest = longestPress;
+
+    return changed;
   }
-  
-  void resetStats() {
-    pressCount = 0;
-    releaseCount = 0;
-    bounceCount = 0;
-    longestPress = 0;
-    shortestPress = 0xFFFFFFFF;
+
+  uint16_t getPressEdges() { return filter.getPressed(); }
+  uint16_t getReleaseEdges() { return filter.getReleased(); }
+
+  bool isPressed(uint8_t index) {
+    if(index >= MAX_BUTTONS) return false;
+    return (filter.getState() >> index) & 1;
   }
-};
 
-// ============= DEBOUNCE GRUPAL =============
-class GroupDebounce {
-private:
-  static const uint8_t MAX_BUTTONS = 16;
-  DebouncedButton buttons[MAX_BUTTONS];
-  uint16_t lastGroupState;
-  uint16_t currentGroupState;
-  
-public:
-  GroupDebounce() : lastGroupState(0), currentGroupState(0) {}
-  
-  // Actualizar todos los botones de una vez
-  bool updateAll(uint16_t rawState) {
-    bool anyChanged = false;
-    currentGroupState = 0;
-    
-    for(uint8_t i = 0; i < MAX_BUTTONS; i++) {
-      bool pinState = (rawState >> i) & 1;
-      
-      if(buttons[i].update(pinState)) {
-        anyChanged = true;
-      }
-      
-      if(buttons[i].isPressed()) {
-        currentGroupState |= (1 << i);
+  // Botones mantenidos al menos threshold ms
+  uint16_t getLongPressed(unsigned long threshold = 1000) {
+    uint16_t held = filter.getState();
+    uint16_t result = 0;
+    unsigned long now = millis();
+
+    while(held) {
+      uint8_t i = __builtin_ctz(held);
+      held &= held - 1;
+      if(now - pressTime[i] >= threshold) {
+        result |= (1 << i);
       }
     }
-    
-    return anyChanged;
-  }
-  
-  // Obtener botón individual
-  DebouncedButton* getButton(uint8_t index) {
-    if(index >= MAX_BUTTONS) return nullptr;
-    return &buttons[index];
+    return result;
   }
   
   // Verificar múltiples botones presionados
   bool arePressed(uint16_t mask) {
-    return (currentGroupState & mask) == mask;
+    return (filter.getState() & mask) == mask;
   }
   
   // Obtener estado completo
-  uint16_t getState() { return currentGroupState; }
-  
-  // Detectar combos
-  bool checkCombo(uint16_t comboMask, unsigned long timeWindow = 100) {
-    static unsigned long lastComboTime = 0;
-    static uint16_t lastComboState = 0;
-    
-    if(arePressed(comboMask)) {
-      if(lastComboState != comboMask) {
-        lastComboState = comboMask;
-        lastComboTime = millis();
-        return true;
-      }
-    } else {
-      if(millis() - lastComboTime > timeWindow) {
-        lastComboState = 0;
-      }
-    }
-    
-    return false;
+  uint16_t getState() { return filter.getState(); }
+
+  void getStats(unsigned long* presses, unsigned long* bounces) {
+    *presses = pressCount;
+    *bounces = bounceCount;
   }
 };
 
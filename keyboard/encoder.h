@@ -3,6 +3,43 @@
 
 #include "config.h"
 #include "debounce.h"
+#include "buffer.h"
+
+// ============= PASOS DECODIFICADOS =============
+// La ISR (o el muestreo por DMA) encola pasos con su timestamp y el loop
+// los vacía en readDirection(), a través de un SpscRing
+struct EncoderStep {
+  unsigned long time;   // micros() del flanco
+  int8_t direction;     // -1/1, o 0 si la transición fue inválida
+  uint8_t from;
+  uint8_t to;
+};
+
+// ============= CURVA DE ACELERACIÓN =============
+constexpr bool encoderAccelSorted() {
+  for(size_t i = 1; i < ENCODER_ACCEL_POINTS; i++) {
+    if(ENCODER_ACCEL_CURVE[i - 1].intervalUs >= ENCODER_ACCEL_CURVE[i].intervalUs) return false;
+  }
+  return true;
+}
+
+static_assert(encoderAccelSorted(), "ENCODER_ACCEL_CURVE debe tener intervalos crecientes");
+
+// Ganancia Q8 para un intervalo entre pasos, interpolada linealmente
+inline uint16_t encoderAccelGain(unsigned long interval) {
+  if(interval <= ENCODER_ACCEL_CURVE[0].intervalUs) return ENCODER_ACCEL_CURVE[0].gain;
+
+  for(uint8_t i = 1; i < ENCODER_ACCEL_POINTS; i++) {
+    const EncoderAccelPoint& upper = ENCODER_ACCEL_CURVE[i];
+    if(interval >= upper.intervalUs) continue;
+
+    const EncoderAccelPoint& lower = ENCODER_ACCEL_CURVE[i - 1];
+    long span = upper.intervalUs - lower.intervalUs;
+    long offset = interval - lower.intervalUs;
+    return lower.gain + ((long)upper.gain - lower.gain) * offset / span;
+  }
+  return ENCODER_ACCEL_CURVE[ENCODER_ACCEL_POINTS - 1].gain;
+}
 
 // ============= CLASE ENCODER ROTATIVO MEJORADA =============
 class RotaryEncoder {
@@ -25,9 +62,14 @@ private:
   
   // Estadísticas y detección de velocidad
   unsigned long lastEventTime;
+  unsigned long stepTime;     // us del primer paso de la última lectura
   unsigned long eventCount;
   int8_t lastDirection;
-  uint8_t speed;  // 0=detenido, 1=lento, 2=medio, 3=rápido
+  unsigned long stepInterval; // Intervalo medio entre pasos (us); 0 = detenido
+  uint16_t gain;              // Pasos de salida por paso físico (Q8)
+  long accumulator;           // Pasos acelerados aún no leídos (Q8)
+  int8_t motion;              // Sentido de la última lectura
+  unsigned long discardedSteps; // Pasos acelerados que no cupieron
   
   // Buffer para suavizar lectura
   int8_t directionBuffer[4];
@@ -36,6 +78,18 @@ private:
   // Detección de errores
   uint8_t errorCount;
   bool isValid;
+
+  #if ENCODER_ISR_ENABLED || ENCODER_DMA_SAMPLING
+  // Modo interrupción o DMA: cada transición decodificada se encola
+  volatile uint8_t isrState;
+  SpscRing<EncoderStep, ENCODER_STEP_QUEUE_SIZE, OVERFLOW_REJECT> stepQueue;
+  #endif
+
+  #if ENCODER_DMA_SAMPLING
+  // Modo DMA: estado candidato y cuántas muestras seguidas lleva
+  uint8_t sampleCandidate;
+  uint8_t sampleCount;
+  #endif
   
 public:
   RotaryEncoder(uint8_t pin_a, uint8_t pin_b) : 
@@ -44,9 +98,14 @@ public:
     currentState(STATE_00),
     lastValidState(STATE_00),
     lastEventTime(0),
+    stepTime(0),
     eventCount(0),
     lastDirection(0),
-    speed(0),
+    stepInterval(0),
+    gain(256),
+    accumulator(0),
+    motion(0),
+    discardedSteps(0),
     bufferIndex(0),
     errorCount(0),
     isValid(true) {
@@ -60,6 +119,13 @@ public:
     bool initB = digitalRead(pinB);
     currentState = (EncoderState)((initA << 1) | initB);
     lastValidState = currentState;
+    #if ENCODER_ISR_ENABLED || ENCODER_DMA_SAMPLING
+    isrState = currentState;
+    #endif
+    #if ENCODER_DMA_SAMPLING
+    sampleCandidate = currentState;
+    sampleCount = 0;
+    #endif
     
     // Inicializar buffer
     for(int i = 0; i < 4; i++) {
@@ -67,14 +133,58 @@ public:
     }
   }
   
+  #if ENCODER_ISR_ENABLED
+  // Activar la decodificación por flanco; isr debe llamar a handleEdge()
+  void beginInterrupts(void (*isr)(void)) {
+    isrState = (digitalRead(pinA) << 1) | digitalRead(pinB);
+    currentState = (EncoderState)isrState;
+    attachInterrupt(digitalPinToInterrupt(pinA), isr, CHANGE);
+    attachInterrupt(digitalPinToInterrupt(pinB), isr, CHANGE);
+  }
+
+  // Llamada desde la ISR en cada flanco de A o B. Un rebote de un solo
+  // canal produce pasos +1/-1 que se cancelan al sumar, sin filtro temporal
+  void handleEdge() {
+    uint8_t newState = (digitalRead(pinA) << 1) | digitalRead(pinB);
+    if(newState == isrState) return;
+
+    queueTransition(newState, micros());
+  }
+  #endif
+
+  #if ENCODER_DMA_SAMPLING
+  // Modo DMA: una muestra del lote (bit 1 = A, bit 0 = B). Un estado se
+  // acepta tras ENCODER_FILTER_SAMPLES muestras iguales seguidas, así que
+  // los glitches más cortos que ese número de periodos se descartan
+  void feedSample(uint8_t state, unsigned long time) {
+    if(state != sampleCandidate) {
+      sampleCandidate = state;
+      sampleCount = 1;
+    } else if(sampleCount < ENCODER_FILTER_SAMPLES) {
+      sampleCount++;
+    }
+
+    if(sampleCount == ENCODER_FILTER_SAMPLES && state != isrState) {
+      queueTransition(state, time);
+    }
+  }
+  #endif
+
+  uint8_t getPinA() { return pinA; }
+  uint8_t getPinB() { return pinB; }
+
   // Leer dirección con detección de velocidad
   int8_t readDirection() {
+    #if ENCODER_ISR_ENABLED || ENCODER_DMA_SAMPLING
+    return drainSteps();
+    #else
     // Leer pines con debounce
     bool pinAState = digitalRead(pinA);
     bool pinBState = digitalRead(pinB);
     
     // Aplicar debounce especializado
     if(!debouncer.update(pinAState, pinBState)) {
+      updateSpeed(0, micros());   // Quieto: también vence la aceleración
       return 0; // Sin cambio estable
     }
     
@@ -86,7 +196,7 @@ public:
     
     // Si no hay cambio, retornar
     if(newState == currentState) {
-      updateSpeed(0);
+      updateSpeed(0, micros());
       return 0;
     }
     
@@ -106,36 +216,54 @@ public:
     currentState = newState;
     
     // Actualizar velocidad
-    updateSpeed(direction);
+    stepTime = micros();
+    updateSpeed(direction, stepTime);
     
     // Aplicar filtro de dirección
     direction = filterDirection(direction);
+    accumulate(direction);
     
     // Actualizar estadísticas
     lastDirection = direction;
     eventCount++;
     
     return direction;
+    #endif
   }
   
-  // Obtener dirección con aceleración (más pasos si gira rápido)
-  int8_t readDirectionWithAcceleration() {
-    int8_t direction = readDirection();
-    
-    if(direction == 0) return 0;
-    
-    // Multiplicar según velocidad
-    switch(speed) {
-      case 0: return 0;
-      case 1: return direction;      // Lento: 1 paso
-      case 2: return direction * 2;  // Medio: 2 pasos
-      case 3: return direction * 3;  // Rápido: 3 pasos
-      default: return direction;
-    }
+  // Pasos acelerados desde la última lectura (con signo), como mucho
+  // maxSteps. Los pasos físicos se acumulan con la ganancia de la curva y
+  // se devuelve la parte entera; la fracción queda para la próxima lectura
+  // y lo que pasa de maxSteps se descarta, para no encolar segundos de
+  // teclas que el host recibiría después de soltar el encoder
+  int16_t readSteps(uint8_t maxSteps) {
+    int8_t net = readDirection();
+    motion = (net > 0) - (net < 0);
+
+    int16_t steps = accumulator / 256;    // Trunca hacia cero
+    if(steps > maxSteps) steps = maxSteps;
+    if(steps < -maxSteps) steps = -maxSteps;
+
+    accumulator -= (long)steps * 256;
+    discardedSteps += labs(accumulator / 256);
+    accumulator %= 256;                   // Sin los pasos que no cupieron
+    return steps;
   }
-  
-  // Obtener velocidad actual
-  uint8_t getSpeed() { return speed; }
+
+  // Sentido del movimiento físico de la última lectura (-1/0/1), aunque no
+  // haya dado pasos por falta de lugar
+  int8_t getMotion() { return motion; }
+
+  // Intervalo medio entre pasos (us; 0 = detenido) y ganancia actual (Q8)
+  unsigned long getStepInterval() { return stepInterval; }
+  uint16_t getGain() { return gain; }
+
+  // Pasos acelerados descartados por pasar de maxSteps o del tope del
+  // acumulador
+  unsigned long getDiscardedSteps() { return discardedSteps; }
+
+  // Cuándo se muestreó el primer paso de la última dirección devuelta (us)
+  unsigned long getStepTime() { return stepTime; }
   
   // Verificar si encoder está funcionando correctamente
   bool isWorking() { return isValid && (errorCount < 10); }
@@ -144,7 +272,10 @@ public:
   void reset() {
     errorCount = 0;
     eventCount = 0;
-    speed = 0;
+    stepInterval = 0;
+    gain = 256;
+    accumulator = 0;
+    discardedSteps = 0;
     isValid = true;
     
     // Re-leer estado actual
@@ -155,13 +286,69 @@ public:
   }
   
   // Obtener estadísticas
-  void getStats(unsigned long* events, uint8_t* errors, uint8_t* currentSpeed) {
+  void getStats(unsigned long* events, uint8_t* errors, uint16_t* currentGain) {
     *events = eventCount;
     *errors = errorCount;
-    *currentSpeed = speed;
+    *currentGain = gain;
   }
+
+  #if ENCODER_ISR_ENABLED || ENCODER_DMA_SAMPLING
+  // Pasos perdidos por cola llena (solo en modo interrupción o DMA)
+  unsigned long getDroppedSteps() { return stepQueue.getOverflows(); }
+  #endif
   
 private:
+  #if ENCODER_ISR_ENABLED || ENCODER_DMA_SAMPLING
+  void queueTransition(uint8_t newState, unsigned long time) {
+    EncoderStep step;
+    step.time = time;
+    step.direction = getDirectionFromTransition((EncoderState)isrState, (EncoderState)newState);
+    step.from = isrState;
+    step.to = newState;
+    stepQueue.push(step);
+
+    isrState = newState;
+  }
+
+  // Vaciar la cola de la ISR: devuelve el desplazamiento neto desde la
+  // última lectura, con la velocidad medida sobre los timestamps de cada paso
+  int8_t drainSteps() {
+    EncoderStep step;
+    int net = 0;
+    bool moved = false;
+
+    while(stepQueue.pop(&step)) {
+      if(step.direction == 0) {
+        handleInvalidTransition((EncoderState)step.from, (EncoderState)step.to);
+        continue;
+      }
+
+      if(!moved) stepTime = step.time;
+      updateSpeed(step.direction, step.time);
+      lastValidState = (EncoderState)step.from;
+      currentState = (EncoderState)step.to;
+      net += step.direction;
+      moved = true;
+    }
+
+    if(!moved) {
+      updateSpeed(0, micros());
+      return 0;
+    }
+
+    if(net == 0) return 0;
+
+    // Los rebotes ya se cancelaron en net: se acelera solo el neto
+    accumulate(net);
+
+    if(net > 127) net = 127;
+    if(net < -127) net = -127;
+    lastDirection = (net > 0) ? 1 : -1;
+    eventCount++;
+    return (int8_t)net;
+  }
+  #endif
+
   // Determinar dirección desde transición de estados
   int8_t getDirectionFromTransition(EncoderState from, EncoderState to) {
     // Tabla de transiciones válidas para encoder en cuadratura
@@ -207,30 +394,55 @@ private:
     #endif
   }
   
-  // Actualizar detección de velocidad
-  void updateSpeed(int8_t direction) {
-    unsigned long now = millis();
+  // Medir la velocidad: promedio móvil del intervalo entre pasos (us)
+  // y la ganancia que le corresponde en la curva
+  void updateSpeed(int8_t direction, unsigned long now) {
     unsigned long timeDelta = now - lastEventTime;
     
     if(direction == 0) {
-      // Sin movimiento
-      if(timeDelta > 500) {
-        speed = 0;
+      // Sin movimiento: al detenerse se vuelve a 1x y se olvida la fracción
+      if(stepInterval != 0 && timeDelta > ENCODER_ACCEL_IDLE_US) {
+        stepInterval = 0;
+        gain = 256;
+        accumulator = 0;
       }
       return;
     }
     
     lastEventTime = now;
-    
-    // Calcular velocidad basada en tiempo entre eventos
-    if(timeDelta < 10) {
-      speed = 3;  // Muy rápido
-    } else if(timeDelta < 50) {
-      speed = 2;  // Medio
-    } else if(timeDelta < 200) {
-      speed = 1;  // Lento
+
+    if(stepInterval == 0 || timeDelta > ENCODER_ACCEL_IDLE_US) {
+      // Primer paso tras detenerse: todavía no hay velocidad
+      stepInterval = ENCODER_ACCEL_IDLE_US;
+      gain = 256;
+      return;
+    }
+
+    if(stepInterval >= ENCODER_ACCEL_IDLE_US) {
+      stepInterval = timeDelta;   // Segundo paso: primera medida
     } else {
-      speed = 0;  // Detenido/iniciando
+      stepInterval += ((long)timeDelta - (long)stepInterval) / (1 << ENCODER_ACCEL_SMOOTHING);
+    }
+
+    #if ENCODER_ACCEL_ENABLED
+    gain = encoderAccelGain(stepInterval);
+    #endif
+  }
+
+  // Sumar pasos físicos al acumulador con la ganancia actual
+  void accumulate(int direction) {
+    // Al invertir el giro se descarta lo pendiente del sentido anterior
+    if((direction > 0 && accumulator < 0) || (direction < 0 && accumulator > 0)) {
+      accumulator = 0;
+    }
+
+    accumulator += (long)direction * gain;
+
+    // Lo que cabe en un evento de teclado (KeyEvent::repeat)
+    long excess = labs(accumulator) - 255L * 256;
+    if(excess > 0) {
+      discardedSteps += excess / 256;
+      accumulator = accumulator > 0 ? 255L * 256 : -255L * 256;
     }
   }
   
@@ -255,6 +467,114 @@ private:
   }
 };
 
+// ============= MUESTREO DE ENCODERS POR DMA =============
+#if ENCODER_DMA_SAMPLING
+// TIM3 genera un update a ENCODER_SAMPLE_RATE y cada update pide a DMA1
+// canal 3 (TIM3_UP) copiar GPIOA->IDR al buffer circular. El CPU no
+// interviene por flanco: update() recorre una vez por tick las muestras
+// nuevas y se las pasa a cada encoder, con su timestamp reconstruido.
+class EncoderSampler {
+private:
+  static_assert((ENCODER_SAMPLE_BUFFER_SIZE & (ENCODER_SAMPLE_BUFFER_SIZE - 1)) == 0,
+                "ENCODER_SAMPLE_BUFFER_SIZE debe ser potencia de 2");
+  static const uint16_t MASK = ENCODER_SAMPLE_BUFFER_SIZE - 1;
+  static const unsigned long SAMPLE_PERIOD_US = 1000000UL / ENCODER_SAMPLE_RATE;
+
+  volatile uint16_t samples[ENCODER_SAMPLE_BUFFER_SIZE];
+  uint16_t readIndex;
+  unsigned long lastUpdate;
+
+  RotaryEncoder* encoders[2];
+  uint8_t bitA[2];
+  uint8_t bitB[2];
+  uint8_t encoderCount;
+
+  // Estadísticas
+  unsigned long samplesDecoded;
+  unsigned long overruns;   // El loop tardó más que el buffer completo
+
+  uint16_t writeIndex() {
+    return (ENCODER_SAMPLE_BUFFER_SIZE - DMA1_Channel3->CNDTR) & MASK;
+  }
+
+public:
+  EncoderSampler() :
+    readIndex(0), lastUpdate(0), encoderCount(0),
+    samplesDecoded(0), overruns(0) {}
+
+  bool addEncoder(RotaryEncoder* encoder) {
+    if(encoderCount >= 2) return false;
+
+    bitA[encoderCount] = STM_PIN(digitalPinToPinName(encoder->getPinA()));
+    bitB[encoderCount] = STM_PIN(digitalPinToPinName(encoder->getPinB()));
+    encoders[encoderCount++] = encoder;
+    return true;
+  }
+
+  void begin() {
+    RCC->APB1ENR |= RCC_APB1ENR_TIM3EN;
+    RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+
+    // DMA1 canal 3: periférico -> memoria, 16 bits, circular
+    DMA1_Channel3->CCR = 0;
+    DMA1_Channel3->CPAR = (uintptr_t)&GPIOA->IDR;
+    DMA1_Channel3->CMAR = (uintptr_t)samples;
+    DMA1_Channel3->CNDTR = ENCODER_SAMPLE_BUFFER_SIZE;
+    DMA1_Channel3->CCR = DMA_CCR_PL_1 | DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_0 |
+                         DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_EN;
+
+    // TIM3 a 72MHz (APB1 x2): solo el update, que dispara la petición DMA
+    TIM3->CR1 = 0;
+    TIM3->PSC = 0;
+    TIM3->ARR = SystemCoreClock / ENCODER_SAMPLE_RATE - 1;
+    TIM3->DIER = TIM_DIER_UDE;
+    TIM3->EGR = TIM_EGR_UG;
+    TIM3->CR1 = TIM_CR1_CEN;
+
+    readIndex = writeIndex();
+    lastUpdate = 0;
+  }
+
+  // Decodificar el lote acumulado desde el tick anterior
+  void update() {
+    unsigned long now = micros();
+    uint16_t end = writeIndex();
+    uint16_t count = (end - readIndex) & MASK;
+
+    // Primer lote: descartar lo acumulado durante el resto de setup()
+    if(lastUpdate == 0) {
+      readIndex = end;
+      lastUpdate = now;
+      return;
+    }
+
+    // Con el buffer completo sin leer no se sabe cuántas vueltas dio el DMA
+    if(now - lastUpdate >= ENCODER_SAMPLE_BUFFER_SIZE * SAMPLE_PERIOD_US) {
+      overruns++;
+    }
+    lastUpdate = now;
+
+    for(uint16_t n = 0; n < count; n++) {
+      uint16_t sample = samples[(readIndex + n) & MASK];
+      unsigned long time = now - (unsigned long)(count - 1 - n) * SAMPLE_PERIOD_US;
+
+      for(uint8_t e = 0; e < encoderCount; e++) {
+        uint8_t state = (((sample >> bitA[e]) & 1) << 1) | ((sample >> bitB[e]) & 1);
+        encoders[e]->feedSample(state, time);
+      }
+    }
+
+    readIndex = end;
+    samplesDecoded += count;
+  }
+
+  void getStats(unsigned long* decoded, unsigned long* lost) {
+    *decoded = samplesDecoded;
+    *lost = overruns;
+  }
+};
+#endif
+
 // ============= GESTOR DE MÚLTIPLES ENCODERS =============
 class EncoderManager {
 private:
@@ -307,8 +627,10 @@ public:
     return encoders[index];
   }
   
-  // Detectar gesto de giro simultáneo
-  bool detectSimultaneousTurn(int8_t* dirA, int8_t* dirB, unsigned long window = 100) {
+  // Detectar gesto de giro simultáneo a partir de las direcciones ya
+  // leídas en este tick (leer de nuevo consumiría los pasos de otro)
+  bool detectSimultaneousTurn(int8_t currentDirA, int8_t currentDirB,
+                              int8_t* dirA, int8_t* dirB, unsigned long window = 100) {
     if(encoderCount < 2) return false;
     
     static unsigned long lastEventA = 0;
@@ -316,9 +638,6 @@ public:
     static int8_t lastDirA = 0;
     static int8_t lastDirB = 0;
     
-    int8_t currentDirA = encoders[0]->readDirection();
-    int8_t currentDirB = encoders[1]->readDirection();
-    
     unsigned long now = millis();
     
     if(currentDirA != 0) {
@@ -332,7 +651,7 @@ public:
     }
     
     // Verificar si ambos eventos ocurrieron dentro de la ventana
-    if(abs((long)lastEventA - (long)lastEventB) < window) {
+    if(abs((long)lastEventA - (long)lastEventB) < (long)window) {
       if(lastDirA != 0 && lastDirB != 0) {
         *dirA = lastDirA;
         *dirB = lastDirB;
@@ -382,9 +701,10 @@ public:
     for(uint8_t i = 0; i < encoderCount; i++) {
       if(encoders[i] != nullptr) {
         unsigned long events;
-        uint8_t errors, speed;
+        uint8_t errors;
+        uint16_t gain;
         
-        encoders[i]->getStats(&events, &errors, &speed);
+        encoders[i]->getStats(&events, &errors, &gain);
         
         Serial.print("Encoder ");
         Serial.print(i);
@@ -392,8 +712,17 @@ public:
         Serial.print(events);
         Serial.print(" Errors=");
         Serial.print(errors);
-        Serial.print(" Speed=");
-        Serial.print(speed);
+        Serial.print(" Interval=");
+        Serial.print(encoders[i]->getStepInterval());
+        Serial.print("us Gain=");
+        Serial.print(gain * 100 / 256);
+        Serial.print("%");
+        Serial.print(" Discarded=");
+        Serial.print(encoders[i]->getDiscardedSteps());
+        #if ENCODER_ISR_ENABLED || ENCODER_DMA_SAMPLING
+        Serial.print(" Dropped=");
+        Serial.print(encoders[i]->getDroppedSteps());
+        #endif
         Serial.print(" Health=");
         Serial.println(encoders[i]->isWorking() ? "OK" : "ERROR");
       }
@@ -0,0 +1,126 @@
+#ifndef I2C_ASYNC_H
+#define I2C_ASYNC_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "config.h"
+
+// ============= MOTOR I2C ASÍNCRONO =============
+// Lecturas del PCF8575 sin bloquear loop(). La transferencia la lleva la
+// ISR de eventos/errores de I2C1 que ya instala el core (twi.c) mediante
+// HAL_I2C_Master_Receive_IT() sobre el handle de Wire; el loop solo arranca
+// la lectura y consulta el resultado en pasadas siguientes.
+//
+// Para 2 bytes la transferencia por interrupción es más barata que
+// configurar un canal DMA, y no hay que competir con twi.c por las ISR.
+
+enum I2CResult {
+  I2C_RESULT_IDLE,        // No hay transferencia en curso
+  I2C_RESULT_BUSY,        // En curso, consultar de nuevo
+  I2C_RESULT_DONE,        // Datos disponibles en getData()/getWord()
+  I2C_RESULT_NACK,        // El esclavo no respondió a su dirección
+  I2C_RESULT_BUS_ERROR,   // Error de bus, arbitraje perdido u overrun
+  I2C_RESULT_TIMEOUT      // No terminó a tiempo: periférico reiniciado
+};
+
+class AsyncI2C {
+private:
+  TwoWire* bus;
+  uint8_t rxBuffer[I2C_ASYNC_MAX_LENGTH];
+  uint8_t rxLength;
+  bool active;
+  unsigned long startTime;
+
+  // Estadísticas
+  unsigned long started;
+  unsigned long completed;
+  unsigned long errors;
+  unsigned long timeouts;
+
+  // Un esclavo que retiene SDA deja la ISR esperando para siempre: se
+  // reinicia el periférico como hace RecoveryManager
+  void resetBus() {
+    bus->end();
+    bus->begin();
+    bus->setClock(I2C_CLOCK_SPEED);
+  }
+
+public:
+  AsyncI2C(TwoWire* wire) :
+    bus(wire), rxLength(0), active(false), startTime(0),
+    started(0), completed(0), errors(0), timeouts(0) {
+    memset(rxBuffer, 0xFF, sizeof(rxBuffer));
+  }
+
+  // Arrancar una lectura; false si hay otra en curso o el HAL la rechaza
+  bool startRead(uint8_t address, uint8_t length) {
+    if(active || length == 0 || length > I2C_ASYNC_MAX_LENGTH) {
+      return false;
+    }
+
+    HAL_StatusTypeDef status = HAL_I2C_Master_Receive_IT(bus->getHandle(),
+                                                         address << 1, rxBuffer, length);
+    if(status != HAL_OK) {
+      errors++;
+      resetBus();
+      return false;
+    }
+
+    rxLength = length;
+    active = true;
+    startTime = micros();
+    started++;
+    return true;
+  }
+
+  // Consultar el resultado sin bloquear; cada resultado final se entrega una vez
+  I2CResult poll() {
+    if(!active) return I2C_RESULT_IDLE;
+
+    I2C_HandleTypeDef* handle = bus->getHandle();
+
+    if(HAL_I2C_GetState(handle) == HAL_I2C_STATE_READY) {
+      active = false;
+      uint32_t error = HAL_I2C_GetError(handle);
+
+      if(error == HAL_I2C_ERROR_NONE) {
+        completed++;
+        return I2C_RESULT_DONE;
+      }
+
+      errors++;
+      return (error & HAL_I2C_ERROR_AF) ? I2C_RESULT_NACK : I2C_RESULT_BUS_ERROR;
+    }
+
+    if(micros() - startTime > I2C_ASYNC_TIMEOUT_US) {
+      active = false;
+      timeouts++;
+      resetBus();
+      return I2C_RESULT_TIMEOUT;
+    }
+
+    return I2C_RESULT_BUSY;
+  }
+
+  bool isBusy() {
+    return active;
+  }
+
+  const uint8_t* getData() {
+    return rxBuffer;
+  }
+
+  // Primeros dos bytes recibidos (P07..P00 y P17..P10 del PCF8575)
+  uint16_t getWord() {
+    return rxBuffer[0] | ((uint16_t)rxBuffer[1] << 8);
+  }
+
+  void getStats(unsigned long* s, unsigned long* c, unsigned long* e, unsigned long* t) {
+    *s = started;
+    *c = completed;
+    *e = errors;
+    *t = timeouts;
+  }
+};
+
+#endif
@@ -0,0 +1,284 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// ============= DIARIO EN FLASH CON NIVELACIÓN DE DESGASTE =============
+// La EEPROM emulada del core borra y reescribe su página de flash por cada
+// byte que cambia. El diario escribe directo en flash con el HAL: cada
+// guardado agrega un registro completo (marca, secuencia, datos, check) al
+// final de la página activa, y solo cuando esta se llena se borra la
+// siguiente de un anillo de JOURNAL_PAGES páginas. El último registro
+// válido, el de mayor secuencia, es la configuración vigente.
+//
+// Un corte de energía a mitad de escritura deja un registro con check
+// inválido que el arranque saltea; el anterior sigue intacto. Cada página
+// guarda en su encabezado cuántas veces se borró.
+
+// Fin de la imagen del firmware en flash. En el linker script del core,
+// .data es la última sección cargada en flash y se copia desde _sidata, así
+// que la imagen termina en _sidata más el tamaño de .data. El simulador
+// define FLASH_IMAGE_END en su HAL.
+#ifndef FLASH_IMAGE_END
+extern "C" uint32_t _sidata, _sdata, _edata;
+#define FLASH_IMAGE_END ((uintptr_t)&_sidata + ((uintptr_t)&_edata - (uintptr_t)&_sdata))
+#endif
+
+#define JOURNAL_PAGE_MAGIC 0x4A43     // "JC"
+#define JOURNAL_RECORD_MAGIC 0x5AA5
+#define JOURNAL_ERASED16 0xFFFF
+
+struct JournalPageHeader {
+  uint16_t magic;
+  uint16_t reserved;
+  uint32_t eraseCount;                // Borrados de vida de esta página
+};
+
+template<typename T>
+class FlashJournal {
+private:
+  // El marcador se escribe primero y el check al final: un registro a medias
+  // ocupa su lugar pero no valida
+  struct Record {
+    uint16_t marker;
+    uint16_t check;
+    uint32_t sequence;
+    T payload;
+  };
+
+  static_assert(sizeof(Record) % 2 == 0, "La flash se programa por medias palabras");
+  static_assert(sizeof(JournalPageHeader) % 2 == 0, "La flash se programa por medias palabras");
+
+  static const uint16_t SLOTS = (FLASH_PAGE_SIZE - sizeof(JournalPageHeader)) / sizeof(Record);
+
+  uintptr_t base;
+  uint8_t pages;
+  bool usable;                        // Las páginas están fuera de la imagen
+
+  uint8_t activePage;
+  uint16_t nextSlot;                  // Primer lugar libre de la página activa
+  uint32_t sequence;                  // Secuencia del último registro válido
+  const Record* latest;
+
+  // Estadísticas desde el arranque
+  unsigned long appends;
+  unsigned long erases;
+  unsigned long programErrors;
+
+  uintptr_t pageAddress(uint8_t page) {
+    return base + (uintptr_t)page * FLASH_PAGE_SIZE;
+  }
+
+  const JournalPageHeader* header(uint8_t page) {
+    return (const JournalPageHeader*)pageAddress(page);
+  }
+
+  const Record* slot(uint8_t page, uint16_t index) {
+    return (const Record*)(pageAddress(page) + sizeof(JournalPageHeader) + index * sizeof(Record));
+  }
+
+  bool pageValid(uint8_t page) {
+    return header(page)->magic == JOURNAL_PAGE_MAGIC;
+  }
+
+  static uint16_t computeCheck(const Record* record) {
+    // Fletcher-16 sobre secuencia y datos
+    const uint8_t* ptr = (const uint8_t*)&record->sequence;
+    uint16_t sum1 = 0, sum2 = 0;
+    for(size_t i = 0; i < sizeof(Record) - offsetof(Record, sequence); i++) {
+      sum1 = (sum1 + ptr[i]) % 255;
+      sum2 = (sum2 + sum1) % 255;
+    }
+    return (sum2 << 8) | sum1;
+  }
+
+  bool recordValid(const Record* record) {
+    return record->marker == JOURNAL_RECORD_MAGIC && record->check == computeCheck(record);
+  }
+
+  // Lugares ocupados: siempre un prefijo de la página, así que basta una
+  // búsqueda binaria sobre el marcador
+  uint16_t usedSlots(uint8_t page) {
+    uint16_t low = 0, high = SLOTS;
+    while(low < high) {
+      uint16_t mid = (low + high) / 2;
+      if(slot(page, mid)->marker != JOURNAL_ERASED16) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    return low;
+  }
+
+  bool program(uintptr_t address, const void* data, size_t length) {
+    const uint16_t* words = (const uint16_t*)data;
+    for(size_t i = 0; i < length / 2; i++) {
+      if(HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, address + 2 * i, words[i]) != HAL_OK) {
+        programErrors++;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool openPage(uint8_t page) {
+    uint32_t count = pageValid(page) ? header(page)->eraseCount : 0;
+
+    FLASH_EraseInitTypeDef erase = {};
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.Banks = FLASH_BANK_1;
+    erase.PageAddress = pageAddress(page);
+    erase.NbPages = 1;
+    uint32_t pageError = 0;
+    if(HAL_FLASHEx_Erase(&erase, &pageError) != HAL_OK) {
+      programErrors++;
+      return false;
+    }
+    erases++;
+
+    JournalPageHeader fresh = {JOURNAL_PAGE_MAGIC, 0, count + 1};
+    if(!program(pageAddress(page), &fresh, sizeof(fresh))) return false;
+
+    activePage = page;
+    nextSlot = 0;
+    return true;
+  }
+
+public:
+  FlashJournal(uintptr_t baseAddress, uint8_t pageCount) :
+    base(baseAddress),
+    pages(pageCount),
+    usable(false),
+    activePage(0),
+    nextSlot(0),
+    sequence(0),
+    latest(0),
+    appends(0),
+    erases(0),
+    programErrors(0) {}
+
+  // Buscar el registro vigente: O(log n) lecturas por página más las
+  // necesarias para saltear registros incompletos al final. Si el firmware
+  // creció hasta las páginas del diario, el diario queda deshabilitado:
+  // borrarlas sería borrar código
+  void begin() {
+    latest = 0;
+    sequence = 0;
+    activePage = 0;
+    nextSlot = SLOTS;   // Sin página abierta: la primera escritura borra
+
+    usable = FLASH_IMAGE_END <= base;
+    if(!usable) return;
+
+    for(uint8_t page = 0; page < pages; page++) {
+      if(!pageValid(page)) continue;
+
+      uint16_t used = usedSlots(page);
+      for(int16_t i = used - 1; i >= 0; i--) {
+        const Record* record = slot(page, i);
+        if(!recordValid(record)) continue;
+
+        if(!latest || (int32_t)(record->sequence - sequence) > 0) {
+          latest = record;
+          sequence = record->sequence;
+          activePage = page;
+          nextSlot = used;
+        }
+        break;
+      }
+    }
+  }
+
+  // Último valor guardado; false si el diario está vacío
+  bool read(T* value) {
+    if(!latest) return false;
+    memcpy(value, &latest->payload, sizeof(T));
+    return true;
+  }
+
+  // Último valor leído directo de flash, sin copiar; 0 si está vacío.
+  // Sigue siendo válido hasta el próximo append().
+  const T* latestValue() {
+    return latest ? &latest->payload : 0;
+  }
+
+  bool matchesLatest(const T& value) {
+    return latest && memcmp(&latest->payload, &value, sizeof(T)) == 0;
+  }
+
+  bool append(const T& value) {
+    if(!usable) return false;
+
+    HAL_FLASH_Unlock();
+
+    bool ok = true;
+    if(nextSlot >= SLOTS || !pageValid(activePage)) {
+      // La página activa tiene el último registro: se borra la siguiente
+      uint8_t next = (latest && pageValid(activePage)) ? (activePage + 1) % pages : activePage;
+      ok = openPage(next);
+    }
+
+    Record record;
+    record.marker = JOURNAL_RECORD_MAGIC;
+    record.sequence = sequence + 1;
+    record.payload = value;
+    record.check = computeCheck(&record);
+
+    if(ok) {
+      uintptr_t address = (uintptr_t)slot(activePage, nextSlot);
+      nextSlot++;
+
+      // Marcador, secuencia y datos; el check cierra el registro
+      ok = program(address, &record.marker, sizeof(record.marker)) &&
+           program(address + offsetof(Record, sequence), &record.sequence,
+                   sizeof(Record) - offsetof(Record, sequence)) &&
+           program(address + offsetof(Record, check), &record.check, sizeof(record.check));
+    }
+
+    HAL_FLASH_Lock();
+    if(!ok) return false;
+
+    const Record* written = slot(activePage, nextSlot - 1);
+    if(!recordValid(written)) return false;
+
+    latest = written;
+    sequence = record.sequence;
+    appends++;
+    return true;
+  }
+
+  // false si la imagen del firmware se superpone con el diario
+  bool isUsable() {
+    return usable;
+  }
+
+  // Borrados de vida de la página más gastada
+  uint32_t getMaxPageErases() {
+    uint32_t worst = 0;
+    if(!usable) return 0;
+    for(uint8_t page = 0; page < pages; page++) {
+      if(pageValid(page) && header(page)->eraseCount > worst) {
+        worst = header(page)->eraseCount;
+      }
+    }
+    return worst;
+  }
+
+  uint16_t getFreeSlots() {
+    return nextSlot < SLOTS ? SLOTS - nextSlot : 0;
+  }
+
+  uint16_t getSlotsPerPage() {
+    return SLOTS;
+  }
+
+  void getStats(unsigned long* writes, unsigned long* pageErases, unsigned long* errors) {
+    *writes = appends;
+    *pageErases = erases;
+    *errors = programErrors;
+  }
+};
+
+#endif
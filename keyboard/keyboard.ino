@@ -5,12 +5,24 @@
 #include "debounce.h"
 #include "encoder.h"
 #include "buffer.h"
+#include "report.h"
+#include "i2c_async.h"
+#include "latency.h"
+#include "profile.h"
+#include "scheduler.h"
+#include "transmit.h"
 #include "watchdog.h"
 #include "storage.h"
+#include "layers.h"
+#include "macro.h"
+#include "tapdance.h"
+#include "combo.h"
+#include "leader.h"
 #include "config_mode.h"
 
 // ============= OBJETOS GLOBALES =============
 PCF8575 pcf8575(PCF8575_ADDRESS);
+AsyncI2C i2cBus(&Wire);
 
 // Sistema de debounce mejorado
 GroupDebounce buttonDebouncer;
@@ -20,32 +32,92 @@ bool lastButtonState[16];
 RotaryEncoder encoderA(ENCODER_A_PIN1, ENCODER_A_PIN2);
 RotaryEncoder encoderB(ENCODER_B_PIN1, ENCODER_B_PIN2);
 EncoderManager encoderManager;
+#if ENCODER_DMA_SAMPLING
+EncoderSampler encoderSampler;
+#endif
 
-// Buffer circular para teclas
-CircularBuffer keyBuffer;
-ComboBuffer comboBuffer;
+// Cola de teclas por prioridad hacia el transmisor HID
+PriorityKeyBuffer keyBuffer;
+
+// Reportes HID por diferencia de estado y transmisor de teclas sueltas
+HidReportEngine hidReport;
+LatencyTracer latencyTracer;
+KeyTransmitter keyTransmitter(&keyBuffer, &hidReport, &latencyTracer);
 
 // Watchdog y monitoreo de salud
 WatchdogManager watchdog;
 SystemHealthMonitor* healthMonitor;
 RecoveryManager recovery;
 
+// Capas sobre el perfil activo
+LayerEngine layerEngine;
+
+// Toque/mantener/multitoque de las teclas TD(n)
+TapDanceEngine tapDance;
+
+// Acordes de COMBOS sobre la máscara de botones
+ComboEngine combos;
+
+// Secuencias tras la tecla líder
+LeaderEngine leader;
+
+// Macros grabadas en flash, reproducidas a través del reporte HID
+MacroEngine macroEngine(&hidReport, &layerEngine);
+
 // Modo configuración
 ConfigMode* configMode;
 
+// Avisos escritos en el host fuera del modo configuración
+ConfigRenderer notices(&keyBuffer);
+
+// ============= TABLA DE TAREAS =============
+// Cambiar el periodo de una tarea no afecta a las demás
+Task tasks[] = {
+  TASK("botones INT", taskButtonEvents, 0, 0, 0),
+  TASK("macros", taskMacros, MACRO_TASK_PERIOD_US, 1, 0),
+  TASK("hid", processKeyBuffer, 0, 1, 0),
+  TASK("encoders", taskEncoders, ENCODER_TASK_PERIOD_US, 2, ENCODER_TASK_DEADLINE_US),
+  TASK("botones", taskButtons, BUTTON_TASK_PERIOD_US, 3, BUTTON_TASK_DEADLINE_US),
+  TASK("serie", processSerialCommands, SERIAL_TASK_PERIOD_US, 5, SERIAL_TASK_PERIOD_US),
+  TASK("i2c check", checkI2CConnection, I2C_CHECK_INTERVAL * 1000UL, 6, I2C_CHECK_DEADLINE_US),
+  TASK("flash", updateStorage, STORAGE_TASK_PERIOD_US, 7, STORAGE_TASK_PERIOD_US),
+  #if DEBUG_MODE
+  TASK("debug", printDebugInfo, DEBUG_PRINT_INTERVAL * 1000UL, 9, DEBUG_TASK_DEADLINE_US),
+  #endif
+};
+
+TaskScheduler scheduler(tasks, sizeof(tasks) / sizeof(tasks[0]));
+
 // Timing no bloqueante
-unsigned long lastMainLoop = 0;
-unsigned long lastI2CCheck = 0;
-unsigned long lastDebugPrint = 0;
 unsigned long loopStartTime = 0;
 
+// Perfilado por zonas (DWT)
+#if PROFILER_ENABLED
+ZoneProfiler zoneProfiler;
+#endif
+
 // Estadísticas del sistema
-SystemStats systemStats = {0, 0, 0, 0, 0, 0, 0};
+SystemStats systemStats = {0, 0, 0, 0, 0, 0, 0, 0};
 
 // Estado de conexión
 bool pcf8575Connected = false;
 uint8_t pcf8575RetryCount = 0;
 
+// Escaneo de botones (INT del PCF8575 y medición de latencia)
+volatile bool pcfInterruptPending = false;
+volatile unsigned long pcfInterruptTime = 0;
+unsigned long lastButtonScan = 0;
+unsigned long buttonReadDetectTime = 0;
+unsigned long buttonSettleUntil = 0;
+
+// Botones mantenidos durante un cambio de perfil: quedan fuera del reporte
+// hasta soltarlos, para que no cambien de código a mitad de pulsación
+uint16_t profileSwitchHeld = 0;
+
+// Teclas del acorde de perfil retenidas a la espera de las demás
+uint16_t profileChordPending = 0;
+unsigned long profileChordStart = 0;
+
 // ============= FUNCIÓN SETUP =============
 void setup() {
   // Inicializar Serial
@@ -55,6 +127,7 @@ void setup() {
   // Inicializar almacenamiento y cargar configuración
   Serial.println("Cargando configuracion...");
   initStorage();
+  macroEngine.begin();
 
   // Inicializar Watchdog
   Serial.println("Configurando watchdog...");
@@ -65,26 +138,54 @@ void setup() {
   // Inicializar I2C
   Serial.println("Iniciando I2C...");
   Wire.begin();
-  Wire.setClock(400000);
+  Wire.setClock(I2C_CLOCK_SPEED);
 
   // Intentar conectar con PCF8575
   connectPCF8575();
 
+  #if PCF8575_INT_ENABLED
+  Serial.println("Escaneo por interrupcion (INT del PCF8575)");
+  pinMode(PCF8575_INT_PIN, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(PCF8575_INT_PIN), pcf8575ISR, FALLING);
+  #endif
+
   // Configurar encoders
   Serial.println("Configurando encoders...");
   encoderManager.addEncoder(&encoderA);
   encoderManager.addEncoder(&encoderB);
 
+  #if ENCODER_ISR_ENABLED
+  encoderA.beginInterrupts(encoderAISR);
+  encoderB.beginInterrupts(encoderBISR);
+  #endif
+
+  #if ENCODER_DMA_SAMPLING
+  encoderSampler.addEncoder(&encoderA);
+  encoderSampler.addEncoder(&encoderB);
+  encoderSampler.begin();
+  #endif
+
   // Inicializar USB HID Keyboard
   Serial.println("Iniciando USB HID...");
+  #if HID_NKRO_ENABLED
+  HID_NKRO_begin();     // Teclado de arranque + interfaz bitmap (report.cpp)
+  #else
   Keyboard.begin();
+  #endif
 
   // Inicializar modo configuración
-  configMode = new ConfigMode();
+  configMode = new ConfigMode(&keyBuffer);
+
+  // El reporte toma los códigos que cada botón fijó al presionarse
+  hidReport.setKeymap(layerEngine.getActiveKeycodes());
 
   // Esperar un poco para la conexión USB
   delay(2000);
 
+  #if PROFILER_ENABLED
+  zoneProfiler.begin();
+  #endif
+
   // Registrar tiempo de inicio
   systemStats.startTime = millis();
 
@@ -92,16 +193,18 @@ void setup() {
   printCurrentConfiguration();
 
   Serial.println("=== SISTEMA LISTO ===");
+  scheduler.begin();
 
-  // Si hubo reset por watchdog, notificar
+  // Si hubo reset por watchdog, notificar: el texto sale por el buffer de
+  // teclas como el del modo configuración, sin pisar el reporte HID
   if(watchdog.wasResetByWatchdog()) {
-    delay(1000);
-    Keyboard.print("[Sistema recuperado de error]");
+    notices.print("[Sistema recuperado de error]");
   }
 }
 
 // ============= LOOP PRINCIPAL NO BLOQUEANTE =============
 void loop() {
+  PROFILE_ZONE(ZONE_LOOP);
   loopStartTime = millis();
 
   // Verificar modo recuperación
@@ -112,111 +215,468 @@ void loop() {
     return;
   }
 
-  // Timing no bloqueante para loop principal
-  if(millis() - lastMainLoop >= MAIN_LOOP_INTERVAL) {
-    lastMainLoop = millis();
-
-    // Procesar buffer de teclas pendientes
-    processKeyBuffer();
+  // Tareas liberadas, en orden de prioridad
+  scheduler.run();
 
-    // Si no estamos en modo config, procesar entrada normal
-    if(!configMode->isActive()) {
-      // Procesar botones
-      if(pcf8575Connected) {
-        processButtons();
-      }
+  // Actualizar métricas de salud
+  {
+    PROFILE_ZONE(ZONE_HEALTH);
 
-      // Procesar encoders
-      processEncoders();
+    unsigned long loopTime = millis() - loopStartTime;
+    if(loopTime > systemStats.longestLoopTime) {
+      systemStats.longestLoopTime = loopTime;
+    }
 
-    } else {
-      // En modo config, solo verificar timeout
-      configMode->checkTimeout();
+    // Verificar salud del sistema y resetear watchdog
+    if(healthMonitor) {
+      healthMonitor->updateLoopTime(loopTime);
+      healthMonitor->performHealthCheck();
     }
-  }
 
-  // Verificación periódica de I2C
-  if(millis() - lastI2CCheck >= I2C_CHECK_INTERVAL) {
-    lastI2CCheck = millis();
-    checkI2CConnection();
+    // Reset condicional del watchdog
+    watchdog.conditionalReset(50);
   }
+}
 
-  // Debug periódico
-  #if DEBUG_MODE
-  if(millis() - lastDebugPrint >= DEBUG_PRINT_INTERVAL) {
-    lastDebugPrint = millis();
-    printDebugInfo();
+// ============= TAREAS =============
+// En cada pasada: recoger la lectura del expansor si la ISR de I2C ya la
+// completó y, con INT, leer ya sin esperar al próximo escaneo
+void taskButtonEvents() {
+  pollButtonRead();
+
+  #if PCF8575_INT_ENABLED
+  if(pcfInterruptPending && pcf8575Connected) {
+    processButtons();
   }
   #endif
+}
 
-  // Actualizar métricas de salud
-  unsigned long loopTime = millis() - loopStartTime;
-  if(loopTime > systemStats.longestLoopTime) {
-    systemStats.longestLoopTime = loopTime;
+void taskButtons() {
+  // En modo config los botones y encoders siguen leyéndose: sus eventos
+  // van a configMode, que escribe sus mensajes de a poco
+  configMode->update();
+  notices.update();
+
+  // Vencimientos de toque/mantener y de la ventana de combos
+  unsigned long now = millis();
+  tapDance.update(now);
+  processTapDanceEvents();
+  combos.update(now);
+  processComboEvents();
+  if(profileChordPending && now - profileChordStart >= PROFILE_SWITCH_WINDOW_MS) {
+    flushProfileChord();
   }
 
-  // Verificar salud del sistema y resetear watchdog
-  if(healthMonitor) {
-    healthMonitor->updateLoopTime(loopTime);
-    healthMonitor->performHealthCheck();
+  LayerKey fired;
+  if(leader.update(now, &fired)) {
+    runLeaderAction(fired);
+  }
+
+  // Con INT: solo mientras rebota o como barrido de seguridad
+  if(pcf8575Connected && isButtonScanDue()) {
+    processButtons();
   }
+}
 
-  // Reset condicional del watchdog
-  watchdog.conditionalReset(50);
+void taskEncoders() {
+  processEncoders();
+}
+
+void taskMacros() {
+  macroEngine.update();
+}
+
+// ============= INTERRUPCIÓN DEL PCF8575 =============
+void pcf8575ISR() {
+  if(!pcfInterruptPending) {
+    pcfInterruptTime = micros();
+  }
+  pcfInterruptPending = true;
+}
+
+// Con INT, el sondeo periódico solo hace falta mientras el estado crudo
+// no coincide con el debounced (rebotes) o como barrido de seguridad
+bool isButtonScanDue() {
+  #if PCF8575_INT_ENABLED
+  unsigned long now = millis();
+  return (long)(buttonSettleUntil - now) > 0 ||
+         now - lastButtonScan >= PCF8575_SAFETY_SCAN_INTERVAL;
+  #else
+  return true;
+  #endif
 }
 
 // ============= PROCESAMIENTO DE BOTONES MEJORADO =============
+// Arranca la lectura del expansor; el resultado llega en pollButtonRead()
 void processButtons() {
-  uint16_t allPins = pcf8575.digitalReadAll();
+  PROFILE_ZONE(ZONE_BUTTONS);
+  if(i2cBus.isBusy()) return;
+
+  unsigned long detectTime = micros();
+
+  #if PCF8575_INT_ENABLED
+  noInterrupts();
+  if(pcfInterruptPending) {
+    detectTime = pcfInterruptTime;
+  }
+  pcfInterruptPending = false;
+  interrupts();
+  #endif
 
-  if(allPins == 0xFFFF && pcf8575RetryCount > 0) {
+  if(i2cBus.startRead(PCF8575_ADDRESS, 2)) {
+    buttonReadDetectTime = detectTime;
+    lastButtonScan = millis();
+    systemStats.i2cTransactions++;
+  } else {
     handleI2CError();
-    return;
+  }
+}
+
+void pollButtonRead() {
+  switch(i2cBus.poll()) {
+    case I2C_RESULT_DONE:
+      pcf8575RetryCount = 0;
+      if(!pcf8575Connected) {
+        pcf8575Connected = true;
+        Serial.println("PCF8575 reconectado");
+      }
+      updateButtons(i2cBus.getWord(), buttonReadDetectTime);
+      break;
+
+    case I2C_RESULT_NACK:
+    case I2C_RESULT_BUS_ERROR:
+    case I2C_RESULT_TIMEOUT:
+      handleI2CError();
+      break;
+
+    default:
+      break;
+  }
+}
+
+void updateButtons(uint16_t allPins, unsigned long detectTime) {
+  PROFILE_ZONE(ZONE_BUTTON_EVENTS);
+  unsigned long acceptTime = micros();
+  bool changed = buttonDebouncer.updateAll(~allPins);
+
+  // Seguir leyendo cada tick hasta que el estado crudo se estabilice
+  if((uint16_t)~allPins != buttonDebouncer.getState()) {
+    buttonSettleUntil = millis() + BUTTON_DEBOUNCE_DELAY + MAIN_LOOP_INTERVAL;
   }
 
-  if(buttonDebouncer.updateAll(~allPins)) {
+  if(changed) {
+    uint16_t state = buttonDebouncer.getState();
+    uint16_t presses = buttonDebouncer.getPressEdges();
+    uint16_t releases = buttonDebouncer.getReleaseEdges();
+    profileSwitchHeld &= ~releases;
 
-    for(int i = 0; i < 16; i++) {
-      DebouncedButton* btn = buttonDebouncer.getButton(i);
+    // Solo el acorde exacto, para no dispararlo con otras teclas mantenidas
+    if((presses & PROFILE_SWITCH_KEYS) && state == PROFILE_SWITCH_KEYS) {
+      switchProfile((getActiveProfile() + 1) % PROFILE_COUNT);
+    }
 
-      if(btn->wasPressed()) {
-        handleButtonPress(i);
-      } else if(btn->wasReleased()) {
-        handleButtonRelease(i);
+    // Resolver la capa de cada flanco antes de armar el reporte
+    unsigned long now = millis();
+    uint16_t edges = releases;
+    while(edges) {
+      uint8_t i = __builtin_ctz(edges);
+      edges &= edges - 1;
+
+      // Soltada antes de completar el acorde de perfil: sale como toque
+      if(profileChordPending & (1 << i)) {
+        flushProfileChord();
       }
 
-      if(btn->isLongPress(CONFIG_HOLD_TIME)) {
-        checkConfigEntry();
+      // Las teclas de un combo no se sueltan por separado
+      bool suppressed = combos.release(i);
+      processComboEvents();
+      if(suppressed) continue;
+
+      tapDance.release(i, now);
+      handleKeyAction(i, layerEngine.release(i), false);
+    }
+    processTapDanceEvents();
+
+    edges = configMode->isActive() ? 0 : presses & ~profileSwitchHeld;
+    while(edges) {
+      uint8_t i = __builtin_ctz(edges);
+      edges &= edges - 1;
+
+      if(holdProfileChord(i, state, now)) continue;
+
+      // Las teclas de combo esperan la ventana; las que ya esperaban y no
+      // forman combo con esta salen antes, en un reporte anterior
+      bool held = combos.press(i, now);
+      if(processComboEvents() && !held) {
+        hidReport.deferButtons(1 << i);
       }
+      if(!held) pressButton(i);
     }
+
+    updateReportButtons();
+
+    if(presses && !configMode->isActive()) {
+      LatencyTrace trace = {detectTime, acceptTime, micros()};
+      latencyTracer.begin(SOURCE_BUTTONS, trace);
+    }
+
+    // Cada flanco se reporta una sola vez
+    while(presses) {
+      uint8_t i = __builtin_ctz(presses);
+      presses &= presses - 1;
+      handleButtonPress(i);
+    }
+
+    while(releases) {
+      uint8_t i = __builtin_ctz(releases);
+      releases &= releases - 1;
+      handleButtonRelease(i);
+    }
+  }
+
+  // Mantener pulsado no genera flancos: revisar en cada lectura
+  if(buttonDebouncer.getLongPressed(CONFIG_HOLD_TIME)) {
+    checkConfigEntry();
   }
 }
 
-// ============= MANEJO DE PRESIÓN DE BOTÓN =============
-void handleButtonPress(uint8_t buttonIndex) {
-  if(configMode->isActive()) {
-    configMode->processButton(buttonIndex);
+// Las teclas mantenidas salen del estado debounced, no de eventos
+void updateReportButtons() {
+  uint16_t buttons = buttonDebouncer.getState() & ~profileSwitchHeld & ~profileChordPending &
+                     ~combos.getSuppressed();
+  hidReport.setButtons(configMode->isActive() ? 0 : buttons);
+}
+
+// ============= ACORDE DE CAMBIO DE PERFIL =============
+// Una tecla de PROFILE_SWITCH_KEYS presionada sin otras fuera del acorde
+// se retiene PROFILE_SWITCH_WINDOW_MS, como las de un combo: si el acorde
+// se completa cambia el perfil sin que ninguna llegue al host. Si vence la
+// ventana, se suelta o llega otra tecla, salen como pulsaciones normales.
+// true: la tecla quedó retenida
+bool holdProfileChord(uint8_t button, uint16_t state, unsigned long now) {
+  if((PROFILE_SWITCH_KEYS & (1 << button)) && !(state & ~PROFILE_SWITCH_KEYS)) {
+    if(!profileChordPending) profileChordStart = now;
+    profileChordPending |= 1 << button;
+    return true;
+  }
+
+  // La tecla que interrumpe va en un reporte posterior a las retenidas
+  if(profileChordPending) {
+    flushProfileChord();
+    hidReport.deferButtons(1 << button);
+  }
+  return false;
+}
+
+void flushProfileChord() {
+  uint16_t keys = profileChordPending;
+  profileChordPending = 0;
+
+  while(keys) {
+    uint8_t i = __builtin_ctz(keys);
+    keys &= keys - 1;
+    pressButton(i);
+    tapIfReleased(i, 1 << i);
+  }
+  updateReportButtons();
+}
+
+// ============= ACCIONES DE TECLA =============
+void pressButton(uint8_t button) {
+  // Una TD pendiente se decide antes que la tecla que la interrumpe; si
+  // salió un toque, la tecla va en un reporte posterior
+  tapDance.otherKeyPressed(button);
+  if(processTapDanceEvents()) {
+    hidReport.deferButtonsToTap(1 << button);
+  }
+
+  LayerKey action = layerEngine.press(button);
+  if(action.type == LAYER_ACTION_KEY && feedLeader(action.arg)) {
+    // Parte de la secuencia líder: no sale por el reporte
+    LayerKey none = XXXX;
+    layerEngine.press(button, none);
     return;
   }
 
-  bool buttonsForConfig[16];
-  for(int i = 0; i < 16; i++) {
-    buttonsForConfig[i] = buttonDebouncer.getButton(i)->isPressed();
+  handleKeyAction(button, action, true);
+}
+
+// Tecla para la secuencia líder en curso; true si la tomó
+bool feedLeader(uint8_t keycode) {
+  if(!leader.isActive()) return false;
+
+  LayerKey fired;
+  if(leader.feed(keycode, millis(), &fired)) {
+    runLeaderAction(fired);
   }
+  return true;
+}
 
-  if(configMode->checkEntry(buttonsForConfig)) {
-    systemStats.configModeEntries++;
+// Acción de una secuencia líder: se ejecuta una vez, no se mantiene
+void runLeaderAction(LayerKey action) {
+  switch(action.type) {
+    case LAYER_ACTION_KEY:
+      keyBuffer.pushKey(action.arg);
+      macroEngine.recordTap(action.arg);
+      break;
+
+    case LAYER_ACTION_TOGGLE:
+      layerEngine.setLayer(action.arg, !(layerEngine.getLayerState() & (1 << action.arg)));
+      break;
+
+    default:
+      handleKeyAction(0, action, true);
+      break;
+  }
+
+  #if DEBUG_MODE
+  Serial.print("Secuencia lider: accion ");
+  Serial.print(action.type);
+  Serial.print(" ");
+  Serial.println(action.arg);
+  #endif
+}
+
+// Una tecla que ya se soltó cuando se resolvió no llega a estar en el
+// reporte: sale como toque
+void tapIfReleased(uint8_t button, uint16_t keys) {
+  if((buttonDebouncer.getState() & keys) == keys) return;
+
+  uint8_t keycode = layerEngine.getActiveKeycodes()[button];
+  if(keycode != 0) {
+    keyBuffer.pushKey(keycode);
+  }
+}
+
+// Combos disparados y teclas que la ventana de combos dejó pasar; true si
+// hubo alguno
+bool processComboEvents() {
+  ComboEvent event;
+  bool any = false;
+
+  while(combos.nextEvent(&event)) {
+    any = true;
+    switch(event.type) {
+      case COMBO_EVENT_PRESS:
+        pressButton(event.button);
+        tapIfReleased(event.button, 1 << event.button);
+        break;
+
+      case COMBO_EVENT_FIRE:
+        tapDance.otherKeyPressed(event.button);
+        if(processTapDanceEvents()) {
+          hidReport.deferButtonsToTap(1 << event.button);
+        }
+        handleKeyAction(event.button, layerEngine.press(event.button, COMBOS[event.index].action), true);
+        hidReport.keymapChanged();
+        tapIfReleased(event.button, COMBOS[event.index].keys);
+
+        #if DEBUG_MODE
+        Serial.print("Combo ");
+        Serial.println(event.index);
+        #endif
+        break;
+
+      case COMBO_EVENT_END:
+        handleKeyAction(event.button, layerEngine.release(event.button), false);
+        hidReport.keymapChanged();
+        break;
+    }
+  }
+
+  if(any) {
+    updateReportButtons();
+  }
+  return any;
+}
+
+// Lo que no resuelve LayerEngine: macros, y grabar lo que sí resuelve
+void handleKeyAction(uint8_t button, LayerKey action, bool pressed) {
+  if(action.type == LAYER_ACTION_TAP_DANCE) {
+    if(pressed) tapDance.press(button, action.arg, millis());
     return;
   }
 
-  uint8_t keycode = BUTTON_MAP[buttonIndex].keycode;
-  uint8_t priority = getKeyPriority(keycode);
+  if(action.type == LAYER_ACTION_LEADER) {
+    if(pressed) leader.start(millis());
+    return;
+  }
 
-  if(!keyBuffer.pushKey(keycode)) {
-    systemStats.bufferOverflows++;
-    if(healthMonitor) {
-      healthMonitor->recordBufferOverflow();
+  if(action.type == LAYER_ACTION_MACRO_PLAY) {
+    if(pressed) macroEngine.play(action.arg);
+    return;
+  }
+
+  if(action.type == LAYER_ACTION_MACRO_RECORD) {
+    if(pressed) macroEngine.toggleRecording(action.arg);
+    return;
+  }
+
+  macroEngine.recordAction(action, pressed);
+}
+
+// Toques y mantener ya decididos por tapDance; true si encoló algún toque
+bool processTapDanceEvents() {
+  TapDanceEvent event;
+  bool queued = false;
+  while(tapDance.nextEvent(&event)) {
+    if(event.type == TAP_DANCE_TAP) {
+      uint8_t keycode = TapDanceEngine::tapKeycode(event.dance, event.count);
+      if(keycode == 0 || feedLeader(keycode)) continue;
+      if(keyBuffer.pushKey(keycode)) queued = true;
+      macroEngine.recordTap(keycode);
+    } else {
+      LayerKey action = TAP_DANCES[event.dance].hold;
+      layerEngine.press(event.button, action);
+      hidReport.keymapChanged();
+      macroEngine.recordAction(action, true);
     }
+
+    #if DEBUG_MODE
+    Serial.print("Boton ");
+    Serial.print(event.button);
+    Serial.print(event.type == TAP_DANCE_TAP ? ": toque x" : ": mantener tras x");
+    Serial.println(event.count);
+    #endif
+  }
+  return queued;
+}
+
+// ============= CAMBIO DE PERFIL =============
+void switchProfile(uint8_t index) {
+  if(configMode->isActive()) return;
+
+  unsigned long start = micros();
+  if(!selectProfile(index)) return;
+  unsigned long elapsed = micros() - start;
+
+  profileSwitchHeld = buttonDebouncer.getState();
+  profileChordPending = 0;
+  hidReport.setButtons(0);
+
+  Serial.print("Perfil ");
+  Serial.print(index + 1);
+  Serial.print(" activo (");
+  Serial.print(elapsed);
+  Serial.println(" us)");
+}
+
+// ============= MANEJO DE PRESIÓN DE BOTÓN =============
+void handleButtonPress(uint8_t buttonIndex) {
+  if(configMode->isActive()) {
+    configMode->processButton(buttonIndex);
+    return;
+  }
+
+  if(configMode->checkEntry(buttonDebouncer.getState())) {
+    hidReport.setButtons(0);
+    layerEngine.clear();
+    tapDance.clear();
+    combos.clear();
+    profileChordPending = 0;
+    leader.cancel();
+    systemStats.configModeEntries++;
+    return;
   }
 
   systemStats.keyPresses++;
@@ -234,19 +694,59 @@ void handleButtonRelease(uint8_t buttonIndex) {
   if(configMode->isActive()) {
     return;
   }
+
+  #if DEBUG_MODE
+  Serial.print("Boton ");
+  Serial.print(buttonIndex);
+  Serial.print(" [");
+  Serial.print(BUTTON_MAP[buttonIndex].description);
+  Serial.println("] liberado");
+  #endif
+}
+
+// ============= INTERRUPCIONES DE ENCODERS =============
+#if ENCODER_ISR_ENABLED
+void encoderAISR() {
+  encoderA.handleEdge();
 }
 
+void encoderBISR() {
+  encoderB.handleEdge();
+}
+#endif
+
 // ============= PROCESAMIENTO DE ENCODERS MEJORADO =============
+// Pasos de encoder que todavía caben: la cola hacia el host no pasa de
+// ENCODER_MAX_PENDING_KEYS teclas (en modo configuración no se encolan)
+uint8_t encoderRoom() {
+  if(configMode->isActive()) return 255;
+
+  uint16_t pending = keyTransmitter.getPendingKeys();
+  return pending < ENCODER_MAX_PENDING_KEYS ? ENCODER_MAX_PENDING_KEYS - pending : 0;
+}
+
 void processEncoders() {
-  int8_t dirA = encoderA.readDirectionWithAcceleration();
+  PROFILE_ZONE(ZONE_ENCODERS);
+  #if ENCODER_DMA_SAMPLING
+  encoderSampler.update();
+  #endif
+
+  int16_t stepsA = encoderA.readSteps(encoderRoom());
+  int8_t dirA = encoderA.getMotion();
   if(dirA != 0) {
     if(configMode->isActive()) {
-      configMode->processEncoder(0, dirA);
-    } else {
-      char key = (dirA > 0) ? ENCODER_MAP[0].right_key : ENCODER_MAP[0].left_key;
-
-      for(int i = 0; i < abs(dirA); i++) {
-        keyBuffer.pushKey(key);
+      if(stepsA != 0) configMode->processEncoder(0, stepsA);
+    } else if(stepsA != 0) {
+      char key = layerEngine.encoderKey(0, dirA > 0);
+      uint8_t count = abs(stepsA);
+
+      // Un solo evento por tick; el transmisor lo expande a ritmo HID
+      keyBuffer.pushRepeat(key, count, encoderA.getStepTime(), micros());
+
+      if(macroEngine.isRecording()) {
+        for(uint8_t i = 0; i < count; i++) {
+          macroEngine.recordTap(key);
+        }
       }
 
       systemStats.encoderEvents++;
@@ -255,20 +755,27 @@ void processEncoders() {
       Serial.print("Encoder A: ");
       Serial.print(dirA > 0 ? "der" : "izq");
       Serial.print(" x");
-      Serial.println(abs(dirA));
+      Serial.println(count);
       #endif
     }
   }
 
-  int8_t dirB = encoderB.readDirectionWithAcceleration();
+  int16_t stepsB = encoderB.readSteps(encoderRoom());
+  int8_t dirB = encoderB.getMotion();
   if(dirB != 0) {
     if(configMode->isActive()) {
-      configMode->processEncoder(1, dirB);
-    } else {
-      char key = (dirB > 0) ? ENCODER_MAP[1].right_key : ENCODER_MAP[1].left_key;
-
-      for(int i = 0; i < abs(dirB); i++) {
-        keyBuffer.pushKey(key);
+      if(stepsB != 0) configMode->processEncoder(1, stepsB);
+    } else if(stepsB != 0) {
+      char key = layerEngine.encoderKey(1, dirB > 0);
+      uint8_t count = abs(stepsB);
+
+      // Un solo evento por tick; el transmisor lo expande a ritmo HID
+      keyBuffer.pushRepeat(key, count, encoderB.getStepTime(), micros());
+
+      if(macroEngine.isRecording()) {
+        for(uint8_t i = 0; i < count; i++) {
+          macroEngine.recordTap(key);
+        }
       }
 
       systemStats.encoderEvents++;
@@ -277,65 +784,70 @@ void processEncoders() {
       Serial.print("Encoder B: ");
       Serial.print(dirB > 0 ? "der" : "izq");
       Serial.print(" x");
-      Serial.println(abs(dirB));
+      Serial.println(count);
       #endif
     }
   }
 
   int8_t simultDirA, simultDirB;
-  if(encoderManager.detectSimultaneousTurn(&simultDirA, &simultDirB)) {
+  if(encoderManager.detectSimultaneousTurn(dirA, dirB, &simultDirA, &simultDirB)) {
     handleEncoderGesture(simultDirA, simultDirB);
   }
 }
 
 // ============= PROCESAR BUFFER DE TECLAS =============
 void processKeyBuffer() {
-  KeyEvent event;
-  uint8_t processed = 0;
+  PROFILE_ZONE(ZONE_KEY_BUFFER);
+  keyTransmitter.update();
 
-  while(keyBuffer.pop(&event) && processed < 5) {
-    sendKey(event.keycode);
-    processed++;
-    delay(KEY_RELEASE_DELAY);
+  if(hidReport.flush()) {
+    latencyTracer.reportSent(micros());
   }
 
-  if(keyBuffer.getCount() > BUFFER_OVERFLOW_THRESHOLD) {
-    Serial.println("¡Buffer cerca del limite!");
+  // Eventos que el buffer perdió según su política de desborde
+  static unsigned long lastOverflows = 0;
+  unsigned long overflows = keyBuffer.getOverflows();
+  if(overflows != lastOverflows) {
+    systemStats.bufferOverflows += overflows - lastOverflows;
+    lastOverflows = overflows;
+    if(healthMonitor) {
+      healthMonitor->recordBufferOverflow();
+    }
   }
-}
 
-// ============= ENVÍO DE TECLAS HID =============
-void sendKey(uint8_t keycode) {
-  Keyboard.press(keycode);
-  delay(KEY_PRESS_DURATION);
-  Keyboard.release(keycode);
-  Keyboard.releaseAll();
+  static bool nearLimit = false;
+  bool overThreshold = keyBuffer.getCount() > BUFFER_OVERFLOW_THRESHOLD;
+  if(overThreshold && !nearLimit) {
+    Serial.println("¡Buffer cerca del limite!");
+  }
+  nearLimit = overThreshold;
 }
 
 // ============= VERIFICAR ENTRADA A MODO CONFIG =============
 void checkConfigEntry() {
-  bool buttonsState[16];
-  for(int i = 0; i < 16; i++) {
-    buttonsState[i] = buttonDebouncer.getButton(i)->isPressed();
-  }
-
-  if(configMode->checkEntry(buttonsState)) {
+  if(configMode->checkEntry(buttonDebouncer.getState())) {
     Serial.println("Entrando a modo configuracion...");
+    // Soltar las teclas de entrada antes de empezar a escribir
+    hidReport.setButtons(0);
+    layerEngine.clear();
+    tapDance.clear();
+    combos.clear();
+    profileChordPending = 0;
+    leader.cancel();
     systemStats.configModeEntries++;
   }
 }
 
 // ============= MANEJAR GESTOS DE ENCODERS =============
 void handleEncoderGesture(int8_t dirA, int8_t dirB) {
+  if(configMode->isActive()) return;
+
+  // Un gesto es una orden explícita: adelanta a los pasos de encoder en cola
   if(dirA > 0 && dirB > 0) {
-    Keyboard.press(KEY_PAGE_DOWN);
-    delay(10);
-    Keyboard.release(KEY_PAGE_DOWN);
+    keyBuffer.push(KEY_PAGE_DOWN, PRIORITY_HIGH);
   }
   else if(dirA < 0 && dirB < 0) {
-    Keyboard.press(KEY_PAGE_UP);
-    delay(10);
-    Keyboard.release(KEY_PAGE_UP);
+    keyBuffer.push(KEY_PAGE_UP, PRIORITY_HIGH);
   }
 }
 
@@ -364,281 +876,261 @@ void connectPCF8575() {
   pcf8575Connected = false;
   handleI2CError();
 }
-#ifndef WATCHDOG_H
-#define WATCHDOG_H
-
-// Para STM32F103 sin librería IWatchdog, usamos el IWDG nativo
-#include <Arduino.h>
-
-// ============= CONFIGURACIÓN WATCHDOG =============
-#define WATCHDOG_TIMEOUT 5000     
-#define WATCHDOG_ENABLED true     
-
-// Registros IWDG para STM32F103
-#define IWDG_KR   (*(volatile uint32_t*)0x40003000)
-#define IWDG_PR   (*(volatile uint32_t*)0x40003004)
-#define IWDG_RLR  (*(volatile uint32_t*)0x40003008)
-#define IWDG_SR   (*(volatile uint32_t*)0x4000300C)
-
-#define IWDG_START    0xCCCC
-#define IWDG_RELOAD   0xAAAA
-#define IWDG_UNLOCK   0x5555
-#define IWDG_LOCK     0x0000
-
-// ============= CLASE WATCHDOG MANAGER =============
-class WatchdogManager {
-private:
-  bool enabled;
-  unsigned long lastReset;
-  unsigned long resetCount;
-  bool wasWatchdogReset;
-  
-public:
-  WatchdogManager() {
-    enabled = WATCHDOG_ENABLED;
-    lastReset = 0;
-    resetCount = 0;
-    wasWatchdogReset = false;
-  }
-  
-  bool init() {
-    if(!enabled) {
-      Serial.println("Watchdog deshabilitado");
-      return false;
-    }
-    
-    // Para STM32F103, configurar IWDG manualmente
-    // Prescaler: 64, Reload: 625 para ~5 segundos @ 40kHz LSI
-    
-    IWDG_KR = IWDG_UNLOCK;  // Desbloquear registros
-    IWDG_PR = 0x5;          // Prescaler /64
-    IWDG_RLR = 3125;        // 5 segundos aprox
-    IWDG_KR = IWDG_START;   // Iniciar watchdog
-    IWDG_KR = IWDG_RELOAD;  // Primer reset
-    
-    Serial.println("Watchdog inicializado: 5 segundos");
-    lastReset = millis();
-    
-    return true;
-  }
-  
-  void reset() {
-    if(!enabled) return;
-    
-    IWDG_KR = IWDG_RELOAD;
-    lastReset = millis();
-    resetCount++;
-  }
-  
-  void conditionalReset(unsigned long minInterval = 100) {
-    if(!enabled) return;
-    
-    unsigned long now = millis();
-    if(now - lastReset >= minInterval) {
-      reset();
-    }
-  }
-  
-  unsigned long getTimeSinceReset() {
-    return millis() - lastReset;
-  }
-  
-  void getStats(unsigned long* resets, unsigned long* lastResetTime, bool* wasReset) {
-    *resets = resetCount;
-    *lastResetTime = lastReset;
-    *wasReset = wasWatchdogReset;
-  }
-  
-  bool isNearTimeout(unsigned long threshold = 1000) {
-    if(!enabled) return false;
-    
-    unsigned long timeSinceReset = getTimeSinceReset();
-    return timeSinceReset >= (WATCHDOG_TIMEOUT - threshold);
-  }
-  
-  void pause() {
-    if(!enabled) return;
-    reset();
-  }
-  
-  void resume() {
-    reset();
-  }
-  
-  bool isEnabled() {
-    return enabled;
-  }
-  
-  bool wasResetByWatchdog() {
-    return wasWatchdogReset;
-  }
-};
 
-// ============= MONITOR DE SALUD DEL SISTEMA =============
-class SystemHealthMonitor {
-private:
-  struct HealthMetrics {
-    unsigned long loopTime;        
-    unsigned long maxLoopTime;     
-    unsigned long i2cErrors;        
-    unsigned long usbErrors;        
-    unsigned long bufferOverflows;  
-    unsigned long lastHealthCheck;  
-  };
-  
-  HealthMetrics metrics;
-  WatchdogManager* watchdog;
-  
-public:
-  SystemHealthMonitor(WatchdogManager* wd) : watchdog(wd) {
-    metrics.loopTime = 0;
-    metrics.maxLoopTime = 0;
-    metrics.i2cErrors = 0;
-    metrics.usbErrors = 0;
-    metrics.bufferOverflows = 0;
-    metrics.lastHealthCheck = 0;
-  }
-  
-  void updateLoopTime(unsigned long time) {
-    metrics.loopTime = time;
-    if(time > metrics.maxLoopTime) {
-      metrics.maxLoopTime = time;
-    }
-    
-    if(time > 100) {
-      Serial.print("¡Loop lento detectado: ");
-      Serial.print(time);
-      Serial.println("ms!");
-    }
-  }
-  
-  void recordI2CError() {
-    metrics.i2cErrors++;
-    checkCriticalErrors();
-  }
-  
-  void recordUSBError() {
-    metrics.usbErrors++;
-    checkCriticalErrors();
-  }
-  
-  void recordBufferOverflow() {
-    metrics.bufferOverflows++;
+// ============= VERIFICACIÓN PERIÓDICA I2C =============
+// Sin lecturas recientes (desconectado, o INT en reposo) se lanza una
+// lectura normal: su resultado confirma o descarta la conexión
+void checkI2CConnection() {
+  PROFILE_ZONE(ZONE_I2C_CHECK);
+  if(!pcf8575Connected || millis() - lastButtonScan >= I2C_CHECK_INTERVAL) {
+    processButtons();
   }
-  
-  void checkCriticalErrors() {
-    if(metrics.i2cErrors > 10) {
-      Serial.println("¡Demasiados errores I2C! Considere reiniciar");
-    }
-  }
-  
-  void performHealthCheck() {
-    unsigned long now = millis();
-    
-    if(now - metrics.lastHealthCheck < 1000) {
-      return;
-    }
-    
-    metrics.lastHealthCheck = now;
-    
-    if(metrics.loopTime < 50 && metrics.i2cErrors < 5) {
-      watchdog->reset();
-    }
-    
-    if(now % 60000 == 0) {
-      metrics.i2cErrors = 0;
-      metrics.usbErrors = 0;
-      metrics.bufferOverflows = 0;
-    }
-  }
-  
-  void printMetrics() {
-    Serial.println("=== METRICAS DE SALUD ===");
-    Serial.print("Loop actual: ");
-    Serial.print(metrics.loopTime);
-    Serial.println("ms");
-    Serial.print("Loop máximo: ");
-    Serial.print(metrics.maxLoopTime);
-    Serial.println("ms");
-    Serial.print("Errores I2C: ");
-    Serial.println(metrics.i2cErrors);
-    Serial.print("Errores USB: ");
-    Serial.println(metrics.usbErrors);
-    Serial.print("Buffer overflows: ");
-    Serial.println(metrics.bufferOverflows);
-    Serial.print("Watchdog resets: ");
-    
-    unsigned long resets, lastReset;
-    bool wasReset;
-    watchdog->getStats(&resets, &lastReset, &wasReset);
-    Serial.println(resets);
-    
-    Serial.println("========================");
-  }
-  
-  void resetMetrics() {
-    metrics.loopTime = 0;
-    metrics.maxLoopTime = 0;
-    metrics.i2cErrors = 0;
-    metrics.usbErrors = 0;
-    metrics.bufferOverflows = 0;
-  }
-};
+}
 
-// ============= RECOVERY MANAGER =============
-class RecoveryManager {
-private:
-  bool inRecoveryMode;
-  unsigned long recoveryStartTime;
-  uint8_t recoveryAttempts;
-  
-public:
-  RecoveryManager() {
-    inRecoveryMode = false;
-    recoveryStartTime = 0;
-    recoveryAttempts = 0;
-  }
-  
-  void enterRecoveryMode() {
-    if(!inRecoveryMode) {
-      inRecoveryMode = true;
-      recoveryStartTime = millis();
-      recoveryAttempts++;
-      
-      Serial.println("=== MODO RECUPERACION ACTIVADO ===");
-      Serial.print("Intento #");
-      Serial.println(recoveryAttempts);
-    }
+// ============= MANEJO DE ERRORES I2C =============
+void handleI2CError() {
+  systemStats.i2cErrors++;
+  pcf8575RetryCount++;
+
+  if(healthMonitor) {
+    healthMonitor->recordI2CError();
   }
-  
-  bool attemptRecovery() {
-    if(!inRecoveryMode) return true;
-    
-    Serial.println("Intentando recuperacion...");
-    
-    Wire.end();
-    delay(100);
-    Wire.begin();
-    
-    unsigned long recoveryTime = millis() - recoveryStartTime;
-    if(recoveryTime > 5000) {
-      Serial.println("Recuperacion fallida - reiniciando sistema");
-      NVIC_SystemReset();
-    }
-    
-    return false;
-  }
-  
-  void exitRecoveryMode() {
-    if(inRecoveryMode) {
-      inRecoveryMode = false;
-      Serial.println("=== SISTEMA RECUPERADO ===");
-    }
+
+  if(pcf8575Connected && pcf8575RetryCount >= PCF8575_MAX_RETRIES) {
+    pcf8575Connected = false;
+    Serial.println("PCF8575 no responde - reintentando conexion");
   }
-  
-  bool isInRecovery() {
-    return inRecoveryMode;
+}
+
+// ============= INFORMACIÓN DE DEBUG =============
+void printDebugInfo() {
+  PROFILE_ZONE(ZONE_DEBUG);
+  unsigned long resets, lastReset;
+  bool wasReset;
+  watchdog.getStats(&resets, &lastReset, &wasReset);
+
+  Serial.println("=== SYSTEM METRICS ===");
+  Serial.print("Uptime: ");
+  Serial.print((millis() - systemStats.startTime) / 1000);
+  Serial.println(" seconds");
+  Serial.print("Loop time: ");
+  Serial.print(millis() - loopStartTime);
+  Serial.print("ms (max: ");
+  Serial.print(systemStats.longestLoopTime);
+  Serial.println("ms)");
+  Serial.print("Key presses: ");
+  Serial.println(systemStats.keyPresses);
+  Serial.print("Encoder events: ");
+  Serial.println(systemStats.encoderEvents);
+  #if ENCODER_DMA_SAMPLING
+  unsigned long samplesDecoded, sampleOverruns;
+  encoderSampler.getStats(&samplesDecoded, &sampleOverruns);
+  Serial.print("Encoder samples: ");
+  Serial.print(samplesDecoded);
+  Serial.print(" (overruns: ");
+  Serial.print(sampleOverruns);
+  Serial.println(")");
+  #endif
+  unsigned long i2cStarted, i2cCompleted, i2cFailed, i2cTimeouts;
+  i2cBus.getStats(&i2cStarted, &i2cCompleted, &i2cFailed, &i2cTimeouts);
+  Serial.print("I2C errors: ");
+  Serial.print(systemStats.i2cErrors);
+  Serial.print(" (bus: ");
+  Serial.print(i2cFailed);
+  Serial.print(", timeouts: ");
+  Serial.print(i2cTimeouts);
+  Serial.println(")");
+
+  static unsigned long lastI2CCount = 0;
+  static unsigned long lastI2CSample = 0;
+  unsigned long now = millis();
+  Serial.print("I2C transactions: ");
+  Serial.print(systemStats.i2cTransactions);
+  if(now > lastI2CSample) {
+    Serial.print(" (");
+    Serial.print(((systemStats.i2cTransactions - lastI2CCount) * 1000UL) / (now - lastI2CSample));
+    Serial.print("/s)");
   }
-};
+  Serial.println(PCF8575_INT_ENABLED ? " [INT]" : " [poll]");
+  lastI2CCount = systemStats.i2cTransactions;
+  lastI2CSample = now;
+
+  LatencyHistogram* total = latencyTracer.getStage(STAGE_TOTAL);
+  Serial.print("Latency (us): p50 ");
+  Serial.print(total->percentile(50));
+  Serial.print(", p99 ");
+  Serial.print(total->percentile(99));
+  Serial.print(", max ");
+  Serial.print(total->getMax());
+  Serial.print(" (n=");
+  Serial.print(total->getCount());
+  Serial.println(")");
+  Serial.print("Buffer: ");
+  Serial.print(keyBuffer.getCount());
+  Serial.print("/");
+  Serial.print(BUFFER_SIZE);
+  Serial.print(" (max: ");
+  Serial.print(keyBuffer.getPeak());
+  Serial.print(", overflows: ");
+  Serial.print(systemStats.bufferOverflows);
+  Serial.print(", coalesced: ");
+  Serial.print(keyBuffer.getCoalesced());
+  Serial.println(")");
+
+  unsigned long txSent;
+  uint8_t txDepth, txPeak;
+  keyTransmitter.getStats(&txSent, &txDepth, &txPeak);
+  Serial.print("HID TX: depth ");
+  Serial.print(txDepth);
+  Serial.print(" (max: ");
+  Serial.print(txPeak);
+  Serial.print("), ");
+  Serial.print(keyTransmitter.sampleRate());
+  Serial.print(" keys/s, sent ");
+  Serial.println(txSent);
+
+  unsigned long reports, rollovers, fallbacks;
+  hidReport.getStats(&reports, &rollovers, &fallbacks);
+  Serial.print("HID reports: ");
+  Serial.print(reports);
+  Serial.print(hidReport.isNkro() ? " [NKRO]" : " [6KRO]");
+  Serial.print(" (rollover: ");
+  Serial.print(rollovers);
+  Serial.print(", NKRO fallbacks: ");
+  Serial.print(fallbacks);
+  Serial.println(")");
+  Serial.print("Watchdog resets: ");
+  Serial.println(resets);
+  printStorageStats();
+  layerEngine.printStats();
+  unsigned long danceTaps, danceHolds;
+  tapDance.getStats(&danceTaps, &danceHolds);
+  Serial.print("Toque/mantener: ");
+  Serial.print(danceTaps);
+  Serial.print(" toques, ");
+  Serial.print(danceHolds);
+  Serial.println(" mantenidas");
+  unsigned long combosFired, combosFlushed;
+  combos.getStats(&combosFired, &combosFlushed);
+  Serial.print("Combos: ");
+  Serial.print(combosFired);
+  Serial.print(" disparados, ");
+  Serial.print(combosFlushed);
+  Serial.println(" teclas devueltas tras la ventana");
+  unsigned long leaderMatched, leaderCancelled;
+  leader.getStats(&leaderMatched, &leaderCancelled);
+  Serial.print("Secuencias lider: ");
+  Serial.print(leaderMatched);
+  Serial.print(" (canceladas ");
+  Serial.print(leaderCancelled);
+  Serial.print(", trie de ");
+  Serial.print(LEADER_NODES);
+  Serial.println(" nodos)");
+  macroEngine.printStats();
+}
+
+// ============= COMANDOS SERIE =============
+void processSerialCommands() {
+  if(!Serial.available()) return;
+
+  char command = Serial.read();
 
-#endif
\ No newline at end of file
+  switch(command) {
+    case 'd':
+      printDebugInfo();
+      if(healthMonitor) {
+        healthMonitor->printMetrics();
+      }
+      encoderManager.printStats();
+      break;
+
+    case 'c':
+      printCurrentConfiguration();
+      break;
+
+    case 'r':
+      systemStats.keyPresses = 0;
+      systemStats.encoderEvents = 0;
+      systemStats.configModeEntries = 0;
+      systemStats.i2cErrors = 0;
+      systemStats.bufferOverflows = 0;
+      systemStats.longestLoopTime = 0;
+      systemStats.i2cTransactions = 0;
+      latencyTracer.reset();
+      #if PROFILER_ENABLED
+      zoneProfiler.reset();
+      #endif
+      keyTransmitter.resetStats();
+      scheduler.resetStats();
+      keyBuffer.resetPeak();
+      if(healthMonitor) {
+        healthMonitor->resetMetrics();
+      }
+      Serial.println("Estadisticas reiniciadas");
+      break;
+
+    case 'R':
+      resetToDefaults();
+      break;
+
+    case 's':
+      saveConfiguration();
+      printStorageStats();
+      break;
+
+    case 'l':
+      latencyTracer.printStats();
+      break;
+
+    case 'p':
+      #if PROFILER_ENABLED
+      zoneProfiler.printStats();
+      #else
+      Serial.println("Perfilado deshabilitado (PROFILER_ENABLED)");
+      #endif
+      break;
+
+    case 't':
+      scheduler.printStats();
+      break;
+
+    case 'n':
+      hidReport.setNkro(!hidReport.isNkro());
+      Serial.print("Modo HID: ");
+      Serial.println(hidReport.isNkro() ? "NKRO" : "6KRO (arranque)");
+      break;
+
+    case 'g':
+      macroEngine.toggleRecording(0);
+      break;
+
+    case 'e':
+      macroEngine.play(0);
+      break;
+
+    case 'h':
+      Serial.println("=== COMANDOS ===");
+      Serial.println("d - Informacion de debug");
+      Serial.println("c - Configuracion actual");
+      Serial.println("r - Reiniciar estadisticas");
+      Serial.println("R - Restaurar configuracion por defecto");
+      Serial.println("s - Guardar configuracion");
+      Serial.println("l - Latencia por etapa (p50/p99/max)");
+      Serial.println("p - Perfil de ciclos por zona");
+      Serial.println("t - Tareas: jitter y plazos perdidos");
+      Serial.println("n - Alternar NKRO / 6KRO");
+      Serial.print("1-");
+      Serial.print(PROFILE_COUNT);
+      Serial.println(" - Cambiar de perfil");
+      Serial.println("g - Grabar macro 1 (empezar/terminar)");
+      Serial.println("e - Reproducir macro 1");
+      Serial.println("h - Esta ayuda");
+      break;
+
+    default:
+      if(command >= '1' && command < '1' + PROFILE_COUNT) {
+        switchProfile(command - '1');
+      }
+      break;
+  }
+}
@@ -0,0 +1,157 @@
+#ifndef KEYCODES_H
+#define KEYCODES_H
+
+#include "config.h"
+
+// ============= OPCIONES DE REMAPEO =============
+// Teclas que recorre cada encoder en el modo configuración
+constexpr uint8_t ENCODER_A_OPTIONS[] = {
+  'a','b','c','d','e','f','g','h','i','j','k','l','m',
+  'n','o','p','q','r','s','t','u','v','w','x','y','z',
+  '0','1','2','3','4','5','6','7','8','9',
+  ' ', KEY_RETURN, KEY_TAB, KEY_ESC, KEY_BACKSPACE
+};
+const uint8_t ENCODER_A_COUNT = sizeof(ENCODER_A_OPTIONS);
+
+constexpr uint8_t ENCODER_B_OPTIONS[] = {
+  KEY_F1, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6,
+  KEY_F7, KEY_F8, KEY_F9, KEY_F10, KEY_F11, KEY_F12,
+  '!','@','#','$','%','^','&','*','(',')','-','=',
+  '[',']','{','}','\\','|',';','\'',',','.','/',
+  KEY_LEFT_ARROW, KEY_RIGHT_ARROW, KEY_UP_ARROW, KEY_DOWN_ARROW
+};
+const uint8_t ENCODER_B_COUNT = sizeof(ENCODER_B_OPTIONS);
+
+// ============= METADATOS DE TECLAS =============
+// Una entrada por keycode (0-255), generada en compilación a partir de
+// AVAILABLE_* y de las listas de opciones, y guardada en flash como
+// constante. Nombre, categoría, posición en las listas de los encoders y
+// prioridad salen con un solo acceso indexado, sin formatear en runtime.
+enum KeyCategory {
+  KEY_CAT_NONE,       // Sin nombre conocido
+  KEY_CAT_LETTER,
+  KEY_CAT_NUMBER,
+  KEY_CAT_FUNCTION,
+  KEY_CAT_SPECIAL,    // Espacio, ENTER, TAB, ESC, flechas...
+  KEY_CAT_SYMBOL
+};
+
+enum KeyOptionList {
+  KEY_OPTIONS_NONE,
+  KEY_OPTIONS_A,      // ENCODER_A_OPTIONS
+  KEY_OPTIONS_B       // ENCODER_B_OPTIONS
+};
+
+#define KEY_NAME_LENGTH 10
+
+struct KeyInfo {
+  char name[KEY_NAME_LENGTH];
+  uint8_t category;
+  uint8_t optionList;
+  uint8_t optionIndex;
+  uint8_t priority;
+};
+
+struct KeyTable {
+  KeyInfo keys[256];
+};
+
+struct KeyNameEntry {
+  uint8_t keycode;
+  const char* name;
+};
+
+constexpr KeyNameEntry SPECIAL_KEY_NAMES[] = {
+  {' ', "SPACE"}, {KEY_RETURN, "ENTER"}, {KEY_TAB, "TAB"}, {KEY_ESC, "ESC"},
+  {KEY_BACKSPACE, "BACKSPACE"}, {KEY_LEFT_ARROW, "LEFT"}, {KEY_RIGHT_ARROW, "RIGHT"},
+  {KEY_UP_ARROW, "UP"}, {KEY_DOWN_ARROW, "DOWN"}, {KEY_PAGE_UP, "PAGE UP"},
+  {KEY_PAGE_DOWN, "PAGE DOWN"}
+};
+
+constexpr void setKeyName(KeyInfo& info, const char* name) {
+  uint8_t i = 0;
+  for(; name[i] && i < KEY_NAME_LENGTH - 1; i++) info.name[i] = name[i];
+  info.name[i] = 0;
+}
+
+template<size_t N>
+constexpr void setCategory(KeyTable& table, const uint8_t (&keys)[N], KeyCategory category) {
+  for(size_t i = 0; i < N; i++) table.keys[keys[i]].category = category;
+}
+
+template<size_t N>
+constexpr void setOptions(KeyTable& table, const uint8_t (&keys)[N], KeyOptionList list) {
+  for(size_t i = 0; i < N; i++) {
+    table.keys[keys[i]].optionList = list;
+    table.keys[keys[i]].optionIndex = i;
+  }
+}
+
+// Misma regla que la cola de prioridades: F1-F12, ESC y ENTER primero,
+// luego letras y números, el resto al final
+constexpr uint8_t priorityFor(uint8_t keycode, uint8_t category) {
+  return (category == KEY_CAT_FUNCTION || keycode == KEY_ESC || keycode == KEY_RETURN)
+           ? PRIORITY_HIGH
+           : (category == KEY_CAT_LETTER || category == KEY_CAT_NUMBER) ? PRIORITY_NORMAL
+                                                                        : PRIORITY_LOW;
+}
+
+constexpr KeyTable buildKeyTable() {
+  KeyTable table = {};
+
+  // Caracteres imprimibles: el propio carácter es el nombre
+  for(uint16_t k = 0x21; k < 0x7F; k++) {
+    table.keys[k].name[0] = (char)k;
+  }
+
+  for(uint8_t f = 0; f < 12; f++) {
+    KeyInfo& info = table.keys[KEY_F1 + f];
+    info.name[0] = 'F';
+    if(f < 9) {
+      info.name[1] = '1' + f;
+    } else {
+      info.name[1] = '1';
+      info.name[2] = '0' + (f - 9);
+    }
+  }
+
+  for(size_t i = 0; i < sizeof(SPECIAL_KEY_NAMES) / sizeof(SPECIAL_KEY_NAMES[0]); i++) {
+    setKeyName(table.keys[SPECIAL_KEY_NAMES[i].keycode], SPECIAL_KEY_NAMES[i].name);
+    table.keys[SPECIAL_KEY_NAMES[i].keycode].category = KEY_CAT_SPECIAL;
+  }
+
+  setCategory(table, AVAILABLE_LETTERS, KEY_CAT_LETTER);
+  setCategory(table, AVAILABLE_NUMBERS, KEY_CAT_NUMBER);
+  setCategory(table, AVAILABLE_FUNCTIONS, KEY_CAT_FUNCTION);
+  setCategory(table, AVAILABLE_SPECIAL, KEY_CAT_SPECIAL);
+  setCategory(table, AVAILABLE_SYMBOLS, KEY_CAT_SYMBOL);
+
+  setOptions(table, ENCODER_A_OPTIONS, KEY_OPTIONS_A);
+  setOptions(table, ENCODER_B_OPTIONS, KEY_OPTIONS_B);
+
+  for(uint16_t k = 0; k < 256; k++) {
+    table.keys[k].priority = priorityFor(k, table.keys[k].category);
+  }
+
+  return table;
+}
+
+constexpr KeyTable KEY_TABLE = buildKeyTable();
+
+static_assert(KEY_TABLE.keys[KEY_F10].name[2] == '0', "Nombres de F10-F12");
+static_assert(KEY_TABLE.keys[KEY_ESC].optionList == KEY_OPTIONS_A, "ESC en opciones del encoder A");
+
+inline const KeyInfo& keyInfo(uint8_t keycode) {
+  return KEY_TABLE.keys[keycode];
+}
+
+// Nombre para mostrar; vacío si la tecla no tiene nombre conocido
+inline const char* keyName(uint8_t keycode) {
+  return KEY_TABLE.keys[keycode].name;
+}
+
+inline uint8_t keyPriority(uint8_t keycode) {
+  return KEY_TABLE.keys[keycode].priority;
+}
+
+#endif
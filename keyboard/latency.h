@@ -0,0 +1,178 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <Arduino.h>
+
+// ============= HISTOGRAMA DE LATENCIA =============
+// Cubetas fijas log-lineales en microsegundos: 0-7us exactas y, por encima,
+// 4 cubetas por potencia de 2 (error máximo 25%) hasta ~2s. Registrar una
+// muestra es O(1) y no usa memoria dinámica; los percentiles se obtienen
+// recorriendo las cubetas acumuladas.
+class LatencyHistogram {
+public:
+  static const uint8_t BUCKETS = 80;
+
+private:
+  uint32_t counts[BUCKETS];
+  uint32_t samples;
+  uint32_t minValue;
+  uint32_t maxValue;
+  uint64_t total;
+
+  static uint8_t bucketFor(uint32_t us) {
+    if(us < 8) return us;
+
+    uint8_t msb = 31 - __builtin_clz(us);
+    uint8_t sub = (us >> (msb - 2)) & 3;
+    uint16_t bucket = 8 + (msb - 3) * 4 + sub;
+    return bucket < BUCKETS ? bucket : BUCKETS - 1;
+  }
+
+  // Límite superior (exclusivo) de una cubeta
+  static uint32_t bucketLimit(uint8_t bucket) {
+    if(bucket < 8) return bucket + 1;
+
+    uint8_t msb = 3 + (bucket - 8) / 4;
+    uint8_t sub = (bucket - 8) % 4;
+    return (uint32_t)(4 + sub + 1) << (msb - 2);
+  }
+
+public:
+  LatencyHistogram() {
+    reset();
+  }
+
+  void reset() {
+    for(uint8_t i = 0; i < BUCKETS; i++) counts[i] = 0;
+    samples = 0;
+    minValue = 0;
+    maxValue = 0;
+    total = 0;
+  }
+
+  void record(uint32_t us) {
+    counts[bucketFor(us)]++;
+    if(samples == 0 || us < minValue) minValue = us;
+    if(us > maxValue) maxValue = us;
+    total += us;
+    samples++;
+  }
+
+  // Percentil (0-100) como límite superior de su cubeta, acotado por el máximo
+  uint32_t percentile(uint8_t pct) {
+    if(samples == 0) return 0;
+
+    uint32_t rank = ((uint64_t)samples * pct + 99) / 100;
+    if(rank == 0) rank = 1;
+
+    uint32_t seen = 0;
+    for(uint8_t i = 0; i < BUCKETS; i++) {
+      seen += counts[i];
+      if(seen >= rank) {
+        uint32_t limit = bucketLimit(i) - 1;
+        return limit < maxValue ? limit : maxValue;
+      }
+    }
+    return maxValue;
+  }
+
+  uint32_t getCount() { return samples; }
+  uint32_t getMin() { return minValue; }
+  uint32_t getMax() { return maxValue; }
+  uint32_t getMean() { return samples ? (uint32_t)(total / samples) : 0; }
+};
+
+// ============= TRAZA DE LATENCIA DE EXTREMO A EXTREMO =============
+// Cada pulsación o tecla en cola lleva sus timestamps (micros()):
+//   sample  - lectura cruda (INT del PCF8575, inicio de la lectura I2C o
+//             flanco del encoder)
+//   accept  - el debounce/decodificador la acepta
+//   enqueue - entra al motor de reportes o a la cola de teclas
+// y el momento en que sale el reporte HID que la contiene cierra la traza.
+struct LatencyTrace {
+  unsigned long sample;
+  unsigned long accept;
+  unsigned long enqueue;
+};
+
+enum LatencyStage {
+  STAGE_DEBOUNCE,    // sample -> accept
+  STAGE_QUEUE,       // accept -> enqueue
+  STAGE_TRANSMIT,    // enqueue -> reporte HID
+  STAGE_TOTAL,       // sample -> reporte HID
+  STAGE_COUNT
+};
+
+enum LatencySource {
+  SOURCE_BUTTONS,    // Primera pulsación aún sin reportar
+  SOURCE_QUEUE,      // Tecla que el transmisor acaba de poner en vuelo
+  SOURCE_COUNT
+};
+
+class LatencyTracer {
+private:
+  LatencyHistogram stages[STAGE_COUNT];
+  LatencyTrace pending[SOURCE_COUNT];
+  bool pendingValid[SOURCE_COUNT];
+
+public:
+  LatencyTracer() {
+    for(uint8_t i = 0; i < SOURCE_COUNT; i++) pendingValid[i] = false;
+  }
+
+  // Abrir una traza; si ya hay una pendiente de la misma fuente se conserva
+  // la más antigua, que es la que mide el peor caso del reporte siguiente
+  void begin(LatencySource source, const LatencyTrace& trace) {
+    if(pendingValid[source]) return;
+    pending[source] = trace;
+    pendingValid[source] = true;
+  }
+
+  void cancel(LatencySource source) {
+    pendingValid[source] = false;
+  }
+
+  // Llamar cuando un reporte HID fue aceptado por el endpoint
+  void reportSent(unsigned long now) {
+    for(uint8_t i = 0; i < SOURCE_COUNT; i++) {
+      if(!pendingValid[i]) continue;
+
+      LatencyTrace& t = pending[i];
+      stages[STAGE_DEBOUNCE].record(t.accept - t.sample);
+      stages[STAGE_QUEUE].record(t.enqueue - t.accept);
+      stages[STAGE_TRANSMIT].record(now - t.enqueue);
+      stages[STAGE_TOTAL].record(now - t.sample);
+      pendingValid[i] = false;
+    }
+  }
+
+  LatencyHistogram* getStage(LatencyStage stage) {
+    return &stages[stage];
+  }
+
+  void reset() {
+    for(uint8_t i = 0; i < STAGE_COUNT; i++) stages[i].reset();
+  }
+
+  void printStats() {
+    static const char* const names[STAGE_COUNT] = {
+      "debounce", "cola", "transmision", "total"
+    };
+
+    Serial.println("=== LATENCIA (us) ===");
+    for(uint8_t i = 0; i < STAGE_COUNT; i++) {
+      LatencyHistogram* h = &stages[i];
+      Serial.print(names[i]);
+      Serial.print(": n=");
+      Serial.print(h->getCount());
+      Serial.print(" p50=");
+      Serial.print(h->percentile(50));
+      Serial.print(" p99=");
+      Serial.print(h->percentile(99));
+      Serial.print(" max=");
+      Serial.println(h->getMax());
+    }
+  }
+};
+
+#endif
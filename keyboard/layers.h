@@ -0,0 +1,206 @@
+#ifndef LAYERS_H
+#define LAYERS_H
+
+#include "config.h"
+#include "storage.h"
+
+// ============= MOTOR DE CAPAS =============
+// Capas estilo QMK sobre el perfil activo: momentánea (MO), conmutada (TG)
+// y de un solo uso (OSL). La resolución de cada botón y encoder a través
+// de las capas transparentes se hace una sola vez, cuando cambia el estado
+// de capas o el mapeo (perfil, remapeo), y queda en una tabla plana: cada
+// evento es un acceso indexado.
+//
+// Al presionar, el botón se queda con la acción resuelta en ese momento;
+// al soltarlo se libera esa misma acción aunque la capa ya haya cambiado.
+class LayerEngine {
+private:
+  // Tabla resuelta para el estado actual
+  LayerKey resolved[16];
+  uint8_t encoderKeys[2][2];
+
+  // Acción tomada por cada botón presionado
+  LayerKey pressedAction[16];
+  uint8_t activeKeycodes[16];   // Lo que lee el reporte HID; 0 = nada
+
+  uint16_t toggledLayers;
+  uint16_t oneShotLayers;
+  uint16_t momentaryLayers;
+
+  uint16_t builtState;
+  uint8_t builtGeneration;
+  bool built;
+
+  // Estadísticas
+  unsigned long rebuilds;
+  unsigned long lookups;
+
+  uint16_t layerState() {
+    return 1 | toggledLayers | oneShotLayers | momentaryLayers;
+  }
+
+  void rebuild(uint16_t state) {
+    for(uint8_t i = 0; i < 16; i++) {
+      LayerKey key = {LAYER_ACTION_KEY, BUTTON_MAP[i].keycode};
+
+      for(int8_t layer = LAYER_COUNT - 1; layer >= 0; layer--) {
+        if(!(state & (1 << layer))) continue;
+        if(LAYER_KEYMAPS[layer][i].type != LAYER_ACTION_TRANSPARENT) {
+          key = LAYER_KEYMAPS[layer][i];
+          break;
+        }
+      }
+
+      resolved[i] = key;
+    }
+
+    for(uint8_t e = 0; e < 2; e++) {
+      for(uint8_t side = 0; side < 2; side++) {
+        uint8_t keycode = side ? ENCODER_MAP[e].right_key : ENCODER_MAP[e].left_key;
+
+        for(int8_t layer = LAYER_COUNT - 1; layer >= 0; layer--) {
+          if(!(state & (1 << layer))) continue;
+          if(LAYER_ENCODERS[layer][e][side] != LAYER_ENCODER_TRANSPARENT) {
+            keycode = LAYER_ENCODERS[layer][e][side];
+            break;
+          }
+        }
+
+        encoderKeys[e][side] = keycode;
+      }
+    }
+
+    builtState = state;
+    builtGeneration = mappingGeneration;
+    built = true;
+    rebuilds++;
+  }
+
+  void ensureBuilt() {
+    uint16_t state = layerState();
+    if(!built || state != builtState || mappingGeneration != builtGeneration) {
+      rebuild(state);
+    }
+  }
+
+  uint16_t layerBit(uint8_t layer) {
+    return layer < LAYER_COUNT ? (1 << layer) : 0;
+  }
+
+public:
+  LayerEngine() :
+    toggledLayers(0),
+    oneShotLayers(0),
+    momentaryLayers(0),
+    builtState(0),
+    builtGeneration(0),
+    built(false),
+    rebuilds(0),
+    lookups(0) {
+    memset(pressedAction, 0, sizeof(pressedAction));
+    memset(activeKeycodes, 0, sizeof(activeKeycodes));
+  }
+
+  // Retorna la acción que tomó el botón
+  LayerKey press(uint8_t button) {
+    ensureBuilt();
+    lookups++;
+    return press(button, resolved[button]);
+  }
+
+  // Fijar una acción dada en vez de la de la tabla: el mantener de un
+  // TD(n) o un combo. release() la deshace como a cualquier otra.
+  LayerKey press(uint8_t button, LayerKey action) {
+    pressedAction[button] = action;
+    activeKeycodes[button] = 0;
+
+    switch(action.type) {
+      case LAYER_ACTION_KEY:
+        activeKeycodes[button] = action.arg;
+        oneShotLayers = 0;    // La tecla ya tomó la capa de un solo uso
+        break;
+
+      case LAYER_ACTION_MOMENTARY:
+        momentaryLayers |= layerBit(action.arg);
+        break;
+
+      case LAYER_ACTION_TOGGLE:
+        toggledLayers ^= layerBit(action.arg);
+        break;
+
+      case LAYER_ACTION_ONESHOT:
+        oneShotLayers |= layerBit(action.arg);
+        break;
+    }
+
+    return action;
+  }
+
+  // Retorna la acción que se libera (la fijada al presionar)
+  LayerKey release(uint8_t button) {
+    LayerKey action = pressedAction[button];
+    pressedAction[button].type = LAYER_ACTION_NONE;
+    activeKeycodes[button] = 0;
+
+    if(action.type == LAYER_ACTION_MOMENTARY) {
+      // Otra tecla puede seguir sosteniendo la misma capa
+      momentaryLayers = 0;
+      for(uint8_t i = 0; i < 16; i++) {
+        if(pressedAction[i].type == LAYER_ACTION_MOMENTARY) {
+          momentaryLayers |= layerBit(pressedAction[i].arg);
+        }
+      }
+    }
+
+    return action;
+  }
+
+  // Activar o desactivar una capa como si fuera conmutada (macros)
+  void setLayer(uint8_t layer, bool on) {
+    if(on) {
+      toggledLayers |= layerBit(layer);
+    } else {
+      toggledLayers &= ~layerBit(layer);
+    }
+  }
+
+  // Tecla de un paso de encoder en la capa actual
+  uint8_t encoderKey(uint8_t encoder, bool right) {
+    ensureBuilt();
+    lookups++;
+    return encoderKeys[encoder][right ? 1 : 0];
+  }
+
+  // Códigos de los botones presionados, por índice (para HidReportEngine)
+  const uint8_t* getActiveKeycodes() {
+    return activeKeycodes;
+  }
+
+  uint16_t getLayerState() {
+    return layerState();
+  }
+
+  // Volver a la capa 0 (p. ej. al entrar en modo configuración)
+  void clear() {
+    toggledLayers = 0;
+    oneShotLayers = 0;
+    momentaryLayers = 0;
+  }
+
+  void getStats(unsigned long* tableRebuilds, unsigned long* keyLookups) {
+    *tableRebuilds = rebuilds;
+    *keyLookups = lookups;
+  }
+
+  void printStats() {
+    Serial.print("Capas activas: 0x");
+    Serial.print(layerState(), HEX);
+    Serial.print(" (tabla reconstruida ");
+    Serial.print(rebuilds);
+    Serial.print(" veces, ");
+    Serial.print(lookups);
+    Serial.println(" consultas)");
+  }
+};
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef LEADER_H
+#define LEADER_H
+
+#include "config.h"
+
+// ============= SECUENCIAS LÍDER =============
+// Tras la tecla LEAD, las pulsaciones siguientes (ya resueltas por capa)
+// recorren un trie de LEADER_SEQUENCES compilado en flash. Cada tecla es
+// una transición: búsqueda binaria entre los hijos del nodo actual, que
+// están contiguos y ordenados por tecla. La secuencia termina:
+//   - en un nodo final sin hijos: dispara ya
+//   - sin transición o tras COMBO_TIMEOUT ms sin teclas: dispara el nodo
+//     final en que quedó, si lo es; si no, se cancela
+// Las teclas dentro de la secuencia no salen por el reporte.
+
+struct LeaderNode {
+  uint16_t firstChild;      // Los hijos son nodos consecutivos
+  uint8_t childCount;
+  uint8_t key;              // Tecla de la arista que llega a este nodo
+  LayerKey action;          // LAYER_ACTION_NONE = no termina secuencia
+};
+
+template<size_t N>
+struct LeaderTrie {
+  LeaderNode nodes[N];
+  uint16_t count;
+};
+
+// Cota: una raíz más un nodo por tecla de cada secuencia
+constexpr size_t leaderMaxNodes() {
+  size_t nodes = 1;
+  for(const LeaderSequence& sequence : LEADER_SEQUENCES) {
+    for(uint8_t i = 0; i < MAX_COMBO_LENGTH && sequence.keys[i]; i++) nodes++;
+  }
+  return nodes;
+}
+
+// Armar el trie con punteros al padre y reescribirlo en orden BFS con los
+// hijos de cada nodo ordenados por tecla; así los hijos de un nodo quedan
+// contiguos y no hace falta guardar aristas
+template<size_t N>
+constexpr LeaderTrie<N> buildLeaderTrie() {
+  uint16_t parent[N] = {};
+  uint8_t key[N] = {};
+  LayerKey action[N] = {};
+  uint16_t count = 1;
+  action[0] = {LAYER_ACTION_NONE, 0};
+
+  for(const LeaderSequence& sequence : LEADER_SEQUENCES) {
+    uint16_t node = 0;
+    for(uint8_t i = 0; i < MAX_COMBO_LENGTH && sequence.keys[i]; i++) {
+      uint16_t child = 0;
+      for(uint16_t c = 1; c < count; c++) {
+        if(parent[c] == node && key[c] == sequence.keys[i]) child = c;
+      }
+      if(child == 0 && count < N) {
+        child = count++;
+        parent[child] = node;
+        key[child] = sequence.keys[i];
+        action[child] = {LAYER_ACTION_NONE, 0};
+      }
+      node = child;
+    }
+    action[node] = sequence.action;
+  }
+
+  LeaderTrie<N> trie = {};
+  uint16_t order[N] = {};     // Nuevo índice -> nodo original
+  uint16_t next = 1;
+  trie.count = count;
+
+  for(uint16_t i = 0; i < count; i++) {
+    uint16_t old = order[i];
+    trie.nodes[i].firstChild = next;
+    trie.nodes[i].key = key[old];
+    trie.nodes[i].action = action[old];
+
+    // Hijos en orden de tecla (las teclas de hermanos no se repiten)
+    int16_t lastKey = -1;
+    while(true) {
+      int16_t best = -1;
+      for(uint16_t c = 1; c < count; c++) {
+        if(parent[c] != old || key[c] <= lastKey) continue;
+        if(best < 0 || key[c] < key[best]) best = c;
+      }
+      if(best < 0) break;
+      order[next++] = best;
+      lastKey = key[best];
+    }
+
+    trie.nodes[i].childCount = next - trie.nodes[i].firstChild;
+  }
+
+  return trie;
+}
+
+constexpr size_t LEADER_NODES = buildLeaderTrie<leaderMaxNodes()>().count;
+constexpr LeaderTrie<LEADER_NODES> LEADER_TRIE = buildLeaderTrie<LEADER_NODES>();
+
+class LeaderEngine {
+private:
+  uint16_t node;
+  bool active;
+  unsigned long lastKeyTime;
+
+  // Estadísticas
+  unsigned long matched;
+  unsigned long cancelled;
+
+  // Terminar en el nodo actual; true si era final
+  bool finish(LayerKey* fired) {
+    active = false;
+    const LeaderNode& current = LEADER_TRIE.nodes[node];
+    if(current.action.type == LAYER_ACTION_NONE) {
+      cancelled++;
+      return false;
+    }
+
+    *fired = current.action;
+    matched++;
+    return true;
+  }
+
+public:
+  LeaderEngine() :
+    node(0),
+    active(false),
+    lastKeyTime(0),
+    matched(0),
+    cancelled(0) {}
+
+  void start(unsigned long now) {
+    node = 0;
+    active = true;
+    lastKeyTime = now;
+  }
+
+  // Una tecla de la secuencia; true si terminó una (acción en fired)
+  bool feed(uint8_t keycode, unsigned long now, LayerKey* fired) {
+    if(!active) return false;
+    lastKeyTime = now;
+
+    const LeaderNode& current = LEADER_TRIE.nodes[node];
+    int16_t low = current.firstChild;
+    int16_t high = current.firstChild + current.childCount - 1;
+    while(low <= high) {
+      int16_t mid = (low + high) / 2;
+      uint8_t key = LEADER_TRIE.nodes[mid].key;
+      if(key == keycode) {
+        node = mid;
+        // Sin continuación posible: no esperar al timeout
+        if(LEADER_TRIE.nodes[node].childCount == 0) {
+          return finish(fired);
+        }
+        return false;
+      }
+      if(key < keycode) {
+        low = mid + 1;
+      } else {
+        high = mid - 1;
+      }
+    }
+
+    return finish(fired);
+  }
+
+  // Vencimiento; llamar periódicamente
+  bool update(unsigned long now, LayerKey* fired) {
+    if(!active || now - lastKeyTime < COMBO_TIMEOUT) return false;
+    return finish(fired);
+  }
+
+  bool isActive() {
+    return active;
+  }
+
+  void cancel() {
+    active = false;
+  }
+
+  void getStats(unsigned long* sequencesMatched, unsigned long* sequencesCancelled) {
+    *sequencesMatched = matched;
+    *sequencesCancelled = cancelled;
+  }
+};
+
+#endif
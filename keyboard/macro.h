@@ -0,0 +1,532 @@
+#ifndef MACRO_H
+#define MACRO_H
+
+#include "config.h"
+#include "journal.h"
+#include "report.h"
+#include "layers.h"
+
+// ============= MACROS =============
+// Cada macro es un bytecode compacto guardado en flash, en su propio diario
+// (páginas 58-59). La reproducción lee el bytecode directo de flash y lo
+// ejecuta de a un cambio de reporte por vez: mantiene sus teclas en
+// HidReportEngine y no avanza hasta que el host tomó el reporte anterior,
+// así que escribe tan rápido como el host acepte sin bloquear el loop.
+//
+// Formato (todas las operaciones ocupan 1 byte de código más argumentos):
+//   PRESS k, RELEASE k, TAP k      tecla k (código de BUTTON_MAP)
+//   WAIT ms                        pausa, ms en varint (7 bits por byte)
+//   TEXT n c1..cn                  n taps de caracteres imprimibles
+//   LAYER_ON l, LAYER_OFF l        capa como si fuera conmutada
+
+// Páginas 58-59, debajo del diario de configuración. Si la imagen del
+// firmware llega hasta ellas el diario se deshabilita y no se graban macros
+#define MACRO_JOURNAL_ADDR (FLASH_BASE + 58 * FLASH_PAGE_SIZE)
+#define MACRO_JOURNAL_PAGES 2
+
+enum MacroOp {
+  MACRO_OP_END = 0x00,
+  MACRO_OP_PRESS,
+  MACRO_OP_RELEASE,
+  MACRO_OP_TAP,
+  MACRO_OP_WAIT,
+  MACRO_OP_TEXT,
+  MACRO_OP_LAYER_ON,
+  MACRO_OP_LAYER_OFF
+};
+
+#define MACRO_NO_OP 0xFFFF
+
+// Todas las macros en un solo registro: longitudes y bytecode seguidos
+struct MacroBank {
+  uint8_t length[MACRO_SLOTS];
+  uint8_t pool[MACRO_POOL_SIZE];
+};
+
+static_assert(sizeof(MacroBank) % 2 == 0, "La flash se programa por medias palabras");
+static_assert(MACRO_RECORD_MAX <= MACRO_POOL_SIZE && MACRO_RECORD_MAX <= 255,
+              "Una macro entra en el banco y su largo en un byte");
+
+FlashJournal<MacroBank> macroJournal(MACRO_JOURNAL_ADDR, MACRO_JOURNAL_PAGES);
+
+class MacroEngine {
+private:
+  HidReportEngine* report;
+  LayerEngine* layers;
+
+  // ---- Grabación ----
+  uint8_t recordBuffer[MACRO_RECORD_MAX];
+  uint8_t recordLength;
+  uint8_t recordSlot;
+  bool recording;
+  bool recordFull;                // Sin lugar: se ignora el resto
+  uint16_t lastOp;                // Inicio de la última operación
+  uint16_t prevOp;                // Inicio de la anterior
+  unsigned long lastEventTime;
+
+  // ---- Reproducción ----
+  const uint8_t* code;            // Bytecode en flash; 0 = detenido
+  uint8_t codeLength;
+  uint8_t pc;
+  uint8_t textLeft;               // Caracteres que faltan del TEXT en curso
+  uint8_t tapPending;             // Tecla a soltar tras el próximo reporte
+  bool waiting;
+  unsigned long waitStart;
+  unsigned long waitMs;
+  uint8_t heldKeys[MACRO_MAX_HELD];
+  uint8_t heldCount;
+
+  // Estadísticas
+  unsigned long played;
+  unsigned long opsRun;
+  unsigned long aborted;
+  unsigned long overflows;        // Grabaciones que no entraron completas
+
+  static bool isText(uint8_t keycode) {
+    return keycode >= 0x20 && keycode < 0x7F;
+  }
+
+  // ---- Grabación ----
+  bool emit(uint8_t byte) {
+    if(recordLength >= MACRO_RECORD_MAX) return false;
+    recordBuffer[recordLength++] = byte;
+    return true;
+  }
+
+  bool beginOp(uint8_t op) {
+    uint16_t start = recordLength;
+    if(!emit(op)) return false;
+    prevOp = lastOp;
+    lastOp = start;
+    return true;
+  }
+
+  // Pausa desde el evento anterior, si vale la pena guardarla
+  bool recordWait() {
+    unsigned long now = millis();
+    unsigned long elapsed = now - lastEventTime;
+    lastEventTime = now;
+
+    if(recordLength == 0 || elapsed < MACRO_MIN_WAIT_MS) return true;
+    if(elapsed > 0xFFFF) elapsed = 0xFFFF;
+
+    if(!beginOp(MACRO_OP_WAIT)) return false;
+    while(elapsed >= 0x80) {
+      if(!emit((elapsed & 0x7F) | 0x80)) return false;
+      elapsed >>= 7;
+    }
+    return emit(elapsed);
+  }
+
+  bool recordKeyOp(uint8_t op, uint8_t arg) {
+    if(recordFull) return false;
+
+    uint8_t saved = recordLength;
+    uint16_t savedLast = lastOp, savedPrev = prevOp;
+
+    if(recordWait() && beginOp(op) && emit(arg)) return true;
+
+    // Sin lugar: la macro termina en la última operación completa. La
+    // grabación sigue abierta hasta que la cierre el usuario, así el
+    // próximo MREC la termina en lugar de empezar otra
+    recordLength = saved;
+    lastOp = savedLast;
+    prevOp = savedPrev;
+    recordFull = true;
+    overflows++;
+
+    Serial.print("Macro ");
+    Serial.print(recordSlot + 1);
+    Serial.println(" llena: se ignora el resto hasta terminar la grabacion");
+    return false;
+  }
+
+  // Un TAP recién cerrado se suma al TEXT o TAP imprimible anterior si no
+  // hubo pausa entre ambos
+  void mergeText() {
+    if(lastOp == MACRO_NO_OP || prevOp == MACRO_NO_OP) return;
+    if(recordBuffer[lastOp] != MACRO_OP_TAP || lastOp + 2 != recordLength) return;
+
+    uint8_t key = recordBuffer[lastOp + 1];
+    if(!isText(key)) return;
+
+    if(recordBuffer[prevOp] == MACRO_OP_TEXT && prevOp + 2 + recordBuffer[prevOp + 1] == lastOp &&
+       recordBuffer[prevOp + 1] < 255) {
+      // TEXT n ... + TAP c -> TEXT n+1 ... c
+      recordBuffer[prevOp + 1]++;
+      recordBuffer[lastOp] = key;
+      recordLength = lastOp + 1;
+      lastOp = prevOp;
+      prevOp = MACRO_NO_OP;
+    } else if(recordBuffer[prevOp] == MACRO_OP_TAP && prevOp + 2 == lastOp &&
+              isText(recordBuffer[prevOp + 1])) {
+      // TAP a + TAP b -> TEXT 2 a b (mismo largo, y crece de a un byte)
+      uint8_t first = recordBuffer[prevOp + 1];
+      recordBuffer[prevOp] = MACRO_OP_TEXT;
+      recordBuffer[prevOp + 1] = 2;
+      recordBuffer[prevOp + 2] = first;
+      recordBuffer[prevOp + 3] = key;
+      lastOp = prevOp;
+      prevOp = MACRO_NO_OP;
+    }
+  }
+
+  // ---- Reproducción ----
+  void holdKey(uint8_t keycode) {
+    if(keycode == 0) return;
+    for(uint8_t i = 0; i < heldCount; i++) {
+      if(heldKeys[i] == keycode) return;
+    }
+    if(heldCount < MACRO_MAX_HELD) {
+      heldKeys[heldCount++] = keycode;
+      report->setMacroKeys(heldKeys, heldCount);
+    }
+  }
+
+  void releaseKey(uint8_t keycode) {
+    for(uint8_t i = 0; i < heldCount; i++) {
+      if(heldKeys[i] == keycode) {
+        heldKeys[i] = heldKeys[--heldCount];
+        report->setMacroKeys(heldKeys, heldCount);
+        return;
+      }
+    }
+  }
+
+  void finishPlayback() {
+    code = 0;
+    textLeft = 0;
+    tapPending = 0;
+    waiting = false;
+    heldCount = 0;
+    report->setMacroKeys(heldKeys, 0);
+  }
+
+  uint8_t fetch() {
+    return pc < codeLength ? code[pc++] : 0;
+  }
+
+  // Ejecutar una operación; false si hay que esperar al host o al reloj
+  bool execute() {
+    uint8_t op = fetch();
+    opsRun++;
+
+    switch(op) {
+      case MACRO_OP_PRESS:
+        holdKey(fetch());
+        return false;
+
+      case MACRO_OP_RELEASE:
+        releaseKey(fetch());
+        return false;
+
+      case MACRO_OP_TAP:
+        tapPending = fetch();
+        holdKey(tapPending);
+        return false;
+
+      case MACRO_OP_TEXT:
+        textLeft = fetch();
+        return true;
+
+      case MACRO_OP_WAIT: {
+        unsigned long ms = 0;
+        uint8_t shift = 0;
+        uint8_t byte;
+        do {
+          byte = fetch();
+          ms |= (unsigned long)(byte & 0x7F) << shift;
+          shift += 7;
+        } while((byte & 0x80) && shift < 21);
+        waiting = true;
+        waitStart = millis();
+        waitMs = ms;
+        return false;
+      }
+
+      case MACRO_OP_LAYER_ON:
+        layers->setLayer(fetch(), true);
+        return true;
+
+      case MACRO_OP_LAYER_OFF:
+        layers->setLayer(fetch(), false);
+        return true;
+
+      default:
+        // END o bytecode desconocido: terminar
+        pc = codeLength;
+        return true;
+    }
+  }
+
+public:
+  MacroEngine(HidReportEngine* hidReport, LayerEngine* layerEngine) :
+    report(hidReport),
+    layers(layerEngine),
+    recordLength(0),
+    recordSlot(0),
+    recording(false),
+    recordFull(false),
+    lastOp(MACRO_NO_OP),
+    prevOp(MACRO_NO_OP),
+    lastEventTime(0),
+    code(0),
+    codeLength(0),
+    pc(0),
+    textLeft(0),
+    tapPending(0),
+    waiting(false),
+    waitStart(0),
+    waitMs(0),
+    heldCount(0),
+    played(0),
+    opsRun(0),
+    aborted(0),
+    overflows(0) {}
+
+  void begin() {
+    macroJournal.begin();
+    if(!macroJournal.isUsable()) {
+      Serial.println("ERROR: el firmware ocupa las paginas de macros; no se podran grabar");
+    }
+  }
+
+  // Bytecode de una macro en flash; length 0 si está vacía
+  const uint8_t* getMacro(uint8_t slot, uint8_t* length) {
+    const MacroBank* bank = macroJournal.latestValue();
+    *length = 0;
+    if(!bank || slot >= MACRO_SLOTS) return 0;
+
+    uint16_t offset = 0;
+    for(uint8_t i = 0; i < slot; i++) {
+      offset += bank->length[i];
+    }
+    if(offset + bank->length[slot] > MACRO_POOL_SIZE) return 0;
+
+    *length = bank->length[slot];
+    return bank->pool + offset;
+  }
+
+  // ============= GRABACIÓN =============
+  bool startRecording(uint8_t slot) {
+    if(slot >= MACRO_SLOTS || recording) return false;
+
+    // Sin diario no hay dónde guardarla: no grabar algo que se pierde
+    if(!macroJournal.isUsable()) {
+      Serial.println("ERROR: macros deshabilitadas (diario sobre el firmware)");
+      return false;
+    }
+    stop();
+
+    recordSlot = slot;
+    recordLength = 0;
+    lastOp = MACRO_NO_OP;
+    prevOp = MACRO_NO_OP;
+    lastEventTime = millis();
+    recording = true;
+    recordFull = false;
+
+    Serial.print("Grabando macro ");
+    Serial.println(slot + 1);
+    return true;
+  }
+
+  // Terminar y guardar en flash (un registro del diario)
+  void stopRecording() {
+    if(!recording) return;
+    recording = false;
+
+    // Rearmar el banco con la macro nueva en su lugar
+    static MacroBank bank;
+    memset(&bank, 0xFF, sizeof(bank));
+    uint16_t used = 0;
+    for(uint8_t i = 0; i < MACRO_SLOTS; i++) {
+      uint8_t length;
+      const uint8_t* data = getMacro(i, &length);
+      if(i == recordSlot) {
+        data = recordBuffer;
+        length = recordLength;
+      }
+
+      if(used + length > MACRO_POOL_SIZE) {
+        Serial.println("ERROR: no hay lugar para la macro");
+        return;
+      }
+
+      bank.length[i] = length;
+      memcpy(bank.pool + used, data, length);
+      used += length;
+    }
+
+    if(macroJournal.matchesLatest(bank) || macroJournal.append(bank)) {
+      Serial.print("Macro ");
+      Serial.print(recordSlot + 1);
+      Serial.print(" guardada (");
+      Serial.print(recordLength);
+      Serial.println(recordFull ? " bytes, truncada)" : " bytes)");
+    } else {
+      Serial.println("ERROR: no se pudo guardar la macro");
+    }
+  }
+
+  void toggleRecording(uint8_t slot) {
+    if(recording) {
+      stopRecording();
+    } else {
+      startRecording(slot);
+    }
+  }
+
+  // Acción de un botón (resuelta por LayerEngine) al presionar o soltar
+  void recordAction(LayerKey action, bool pressed) {
+    if(!recording) return;
+
+    switch(action.type) {
+      case LAYER_ACTION_KEY:
+        if(pressed) {
+          recordKeyOp(MACRO_OP_PRESS, action.arg);
+        } else {
+          recordRelease(action.arg);
+        }
+        break;
+
+      case LAYER_ACTION_MOMENTARY:
+        recordKeyOp(pressed ? MACRO_OP_LAYER_ON : MACRO_OP_LAYER_OFF, action.arg);
+        break;
+
+      case LAYER_ACTION_TOGGLE:
+        if(pressed) {
+          bool on = layers->getLayerState() & (1 << action.arg);
+          recordKeyOp(on ? MACRO_OP_LAYER_ON : MACRO_OP_LAYER_OFF, action.arg);
+        }
+        break;
+    }
+  }
+
+  // PRESS k + soltar k enseguida -> TAP k. La pausa hasta el próximo
+  // evento se sigue midiendo desde el PRESS.
+  void recordRelease(uint8_t keycode) {
+    if(lastOp != MACRO_NO_OP && recordBuffer[lastOp] == MACRO_OP_PRESS &&
+       recordBuffer[lastOp + 1] == keycode && millis() - lastEventTime < MACRO_MIN_WAIT_MS) {
+      recordBuffer[lastOp] = MACRO_OP_TAP;
+      mergeText();
+      return;
+    }
+
+    recordKeyOp(MACRO_OP_RELEASE, keycode);
+  }
+
+  // Pasos de encoder y otras teclas sueltas
+  void recordTap(uint8_t keycode) {
+    if(!recording) return;
+    if(recordKeyOp(MACRO_OP_TAP, keycode)) {
+      mergeText();
+    }
+  }
+
+  // ============= REPRODUCCIÓN =============
+  bool play(uint8_t slot) {
+    if(recording) return false;
+
+    // Volver a tocar una macro en curso la corta
+    if(code) {
+      stop();
+      return false;
+    }
+
+    uint8_t length;
+    const uint8_t* data = getMacro(slot, &length);
+    if(!data || length == 0) return false;
+
+    code = data;
+    codeLength = length;
+    pc = 0;
+    played++;
+    return true;
+  }
+
+  void stop() {
+    if(code) {
+      aborted++;
+      finishPlayback();
+    }
+  }
+
+  // Llamar en cada pasada. Avanza como mucho MACRO_MAX_HELD operaciones
+  // sin reporte (capas, TEXT) antes de ceder, así que nunca bloquea.
+  void update() {
+    if(!code) return;
+
+    // El host todavía no tomó el último cambio
+    if(report->isPending()) return;
+
+    if(waiting) {
+      if(millis() - waitStart < waitMs) return;
+      waiting = false;
+    }
+
+    if(tapPending) {
+      releaseKey(tapPending);
+      tapPending = 0;
+      return;
+    }
+
+    for(uint8_t budget = 0; budget < MACRO_MAX_HELD; budget++) {
+      if(textLeft) {
+        textLeft--;
+        tapPending = fetch();
+        holdKey(tapPending);
+        return;
+      }
+
+      if(pc >= codeLength) {
+        finishPlayback();
+        return;
+      }
+
+      if(!execute()) return;
+    }
+  }
+
+  bool isRecording() {
+    return recording;
+  }
+
+  bool isPlaying() {
+    return code != 0;
+  }
+
+  void getStats(unsigned long* macrosPlayed, unsigned long* ops, unsigned long* stopped) {
+    *macrosPlayed = played;
+    *ops = opsRun;
+    *stopped = aborted;
+  }
+
+  void printStats() {
+    uint16_t used = 0;
+    for(uint8_t i = 0; i < MACRO_SLOTS; i++) {
+      uint8_t length;
+      getMacro(i, &length);
+      used += length;
+    }
+
+    Serial.print("Macros: ");
+    Serial.print(used);
+    Serial.print("/");
+    Serial.print(MACRO_POOL_SIZE);
+    Serial.print(" bytes, reproducidas ");
+    Serial.print(played);
+    Serial.print(" (");
+    Serial.print(opsRun);
+    Serial.print(" operaciones, cortadas ");
+    Serial.print(aborted);
+    Serial.print(", llenas ");
+    Serial.print(overflows);
+    Serial.print(")");
+    if(recording) Serial.print(recordFull ? " [grabando, llena]" : " [grabando]");
+    if(code) Serial.print(" [reproduciendo]");
+    Serial.println();
+  }
+};
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// ============= PERFILADO POR ZONAS (DWT CYCCNT) =============
+// El contador de ciclos del Cortex-M3 avanza a la frecuencia de la CPU
+// (72MHz en la Blue Pill), así que cada zona se mide con resolución de
+// ~14ns por dos lecturas de registro. Las zonas se anidan: el tiempo de una
+// zona incluye el de las que llama (p. ej. checkI2CConnection -> botones).
+// CYCCNT es de 32 bits y da la vuelta cada ~59s; una zona individual
+// nunca se acerca a eso y la resta sin signo lo absorbe.
+
+enum ProfileZone {
+  ZONE_LOOP,          // Pasada completa de loop()
+  ZONE_BUTTONS,       // processButtons(): arranque de la lectura I2C
+  ZONE_BUTTON_EVENTS, // updateButtons(): debounce, flancos y reporte
+  ZONE_ENCODERS,      // processEncoders()
+  ZONE_KEY_BUFFER,    // processKeyBuffer()
+  ZONE_I2C_CHECK,     // checkI2CConnection()
+  ZONE_DEBUG,         // printDebugInfo()
+  ZONE_HEALTH,        // Métricas de salud y watchdog
+  ZONE_COUNT
+};
+
+#if PROFILER_ENABLED
+
+class ZoneProfiler {
+private:
+  struct ZoneStats {
+    unsigned long count;
+    uint32_t minCycles;
+    uint32_t maxCycles;
+    uint64_t totalCycles;
+  };
+
+  ZoneStats zones[ZONE_COUNT];
+  uint32_t cyclesPerUs;
+
+public:
+  ZoneProfiler() : cyclesPerUs(1) {
+    reset();
+  }
+
+  // Habilitar la traza y arrancar CYCCNT
+  void begin() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    cyclesPerUs = SystemCoreClock / 1000000;
+    if(cyclesPerUs == 0) cyclesPerUs = 1;
+  }
+
+  inline uint32_t now() {
+    return DWT->CYCCNT;
+  }
+
+  inline void record(ProfileZone zone, uint32_t cycles) {
+    ZoneStats& z = zones[zone];
+    if(z.count == 0 || cycles < z.minCycles) z.minCycles = cycles;
+    if(cycles > z.maxCycles) z.maxCycles = cycles;
+    z.totalCycles += cycles;
+    z.count++;
+  }
+
+  void reset() {
+    for(uint8_t i = 0; i < ZONE_COUNT; i++) {
+      zones[i].count = 0;
+      zones[i].minCycles = 0;
+      zones[i].maxCycles = 0;
+      zones[i].totalCycles = 0;
+    }
+  }
+
+  void getStats(ProfileZone zone, unsigned long* count, uint32_t* minCycles,
+                uint32_t* meanCycles, uint32_t* maxCycles) {
+    ZoneStats& z = zones[zone];
+    *count = z.count;
+    *minCycles = z.minCycles;
+    *meanCycles = z.count ? (uint32_t)(z.totalCycles / z.count) : 0;
+    *maxCycles = z.maxCycles;
+  }
+
+  void printStats() {
+    static const char* const names[ZONE_COUNT] = {
+      "loop", "botones", "flancos", "encoders", "buffer", "i2c check", "debug", "salud"
+    };
+
+    Serial.print("=== PERFIL (ciclos, ");
+    Serial.print(cyclesPerUs);
+    Serial.println(" por us) ===");
+
+    for(uint8_t i = 0; i < ZONE_COUNT; i++) {
+      unsigned long count;
+      uint32_t minCycles, meanCycles, maxCycles;
+      getStats((ProfileZone)i, &count, &minCycles, &meanCycles, &maxCycles);
+
+      Serial.print(names[i]);
+      Serial.print(": n=");
+      Serial.print(count);
+      Serial.print(" min=");
+      Serial.print(minCycles);
+      Serial.print(" media=");
+      Serial.print(meanCycles);
+      Serial.print(" max=");
+      Serial.print(maxCycles);
+      Serial.print(" (");
+      Serial.print(maxCycles / cyclesPerUs);
+      Serial.println("us)");
+    }
+  }
+};
+
+extern ZoneProfiler zoneProfiler;
+
+// Mide desde su construcción hasta que sale de ámbito (incluye returns)
+class ProfileScope {
+private:
+  ProfileZone zone;
+  uint32_t start;
+
+public:
+  ProfileScope(ProfileZone z) : zone(z), start(zoneProfiler.now()) {}
+
+  ~ProfileScope() {
+    zoneProfiler.record(zone, zoneProfiler.now() - start);
+  }
+};
+
+#define PROFILE_ZONE(zone) ProfileScope profileScope_(zone)
+
+#else
+
+#define PROFILE_ZONE(zone)
+
+#endif
+
+#endif
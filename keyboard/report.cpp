@@ -0,0 +1,298 @@
+#include <stdint.h>
+#include <string.h>
+
+// Transporte NKRO (ver report.h). No incluye report.h: config.h define
+// variables globales y solo puede entrar en la unidad del sketch.
+#define NKRO_REPORT_SIZE 17         // HID_NKRO_REPORT_SIZE de report.h
+
+#if defined(USBCON) && defined(USBD_USE_HID_COMPOSITE) && !defined(HOST_SIM)
+
+// ============= INTERFAZ NKRO SOBRE EL HID COMPUESTO DEL CORE =============
+// El core stm32duino registra un dispositivo HID compuesto (teclado de
+// arranque + mouse). HID_NKRO_begin() lo registra envuelto en una clase que
+// agrega una interfaz más, sin subclase de arranque, con el descriptor
+// bitmap y su propio endpoint IN. Las peticiones y endpoints del core se
+// delegan sin cambios, así que HID_Composite_keyboard_sendReport() sigue
+// funcionando para el reporte de arranque.
+//
+// El host que pone el teclado en protocolo de arranque (un BIOS) no usa la
+// interfaz NKRO: HID_NKRO_sendReport() devuelve false y el motor vuelve al
+// reporte de 6 teclas. Lo mismo si el host deja de recoger el endpoint.
+
+#include <Arduino.h>
+#include "usbd_core.h"
+#include "usbd_ctlreq.h"
+#include "usbd_ioreq.h"
+#include "usbd_desc.h"
+#include "usbd_hid_composite.h"
+
+extern USBD_HandleTypeDef hUSBD_Device_HID;     // usbd_hid_composite_if.c
+
+#define NKRO_EPIN_ADDR 0x83         // El core usa 0x81 y 0x82
+#define NKRO_PMA_ADDR 0x100         // Después de EP0 y los endpoints del core
+#define NKRO_POLL_MS 1
+#define NKRO_STALL_MS 50            // Endpoint sin recoger: el host no la usa
+#define NKRO_CONFIG_DESC_MAX 128
+
+#define NKRO_DESC_HID 0x21
+#define NKRO_DESC_REPORT 0x22
+#define NKRO_REQ_GET_IDLE 0x02
+#define NKRO_REQ_GET_PROTOCOL 0x03
+#define NKRO_REQ_SET_IDLE 0x0A
+#define NKRO_REQ_SET_PROTOCOL 0x0B
+
+// Byte de modificadores + bitmap de 128 teclas
+static const uint8_t NKRO_REPORT_DESCRIPTOR[] = {
+  0x05, 0x01,        // Usage Page (Generic Desktop)
+  0x09, 0x06,        // Usage (Keyboard)
+  0xA1, 0x01,        // Collection (Application)
+  0x05, 0x07,        //   Usage Page (Keyboard/Keypad)
+  0x19, 0xE0,        //   Usage Minimum (Left Control)
+  0x29, 0xE7,        //   Usage Maximum (Right GUI)
+  0x15, 0x00,        //   Logical Minimum (0)
+  0x25, 0x01,        //   Logical Maximum (1)
+  0x75, 0x01,        //   Report Size (1)
+  0x95, 0x08,        //   Report Count (8)
+  0x81, 0x02,        //   Input (Data, Variable, Absolute) - modificadores
+  0x19, 0x00,        //   Usage Minimum (0)
+  0x29, 0x7F,        //   Usage Maximum (127)
+  0x95, 0x80,        //   Report Count (128)
+  0x81, 0x02,        //   Input (Data, Variable, Absolute) - bitmap
+  0xC0               // End Collection
+};
+
+// Interfaz + HID + endpoint que se agregan al descriptor de configuración
+#define NKRO_INTERFACE_DESC_SIZE (9 + 9 + 7)
+
+static uint8_t nkroHidDescriptor[9] = {
+  0x09, NKRO_DESC_HID,
+  0x11, 0x01,                       // HID 1.11
+  0x00,                             // Sin país
+  0x01, NKRO_DESC_REPORT,
+  sizeof(NKRO_REPORT_DESCRIPTOR) & 0xFF, sizeof(NKRO_REPORT_DESCRIPTOR) >> 8
+};
+
+static USBD_ClassTypeDef nkroClass;
+static uint8_t nkroConfigDesc[NKRO_CONFIG_DESC_MAX];
+static uint8_t nkroInterface = 0xFF;  // Se fija al armar el descriptor
+static uint8_t nkroReport[NKRO_REPORT_SIZE];
+static uint8_t nkroIdle = 0;
+static uint8_t nkroProtocol = 1;
+static bool nkroConfigured = false;
+static volatile bool bootProtocol = false;
+static volatile bool nkroBusy = false;
+static volatile bool nkroPending = false;
+static unsigned long nkroBusySince = 0;
+
+// Copia el descriptor del core y le agrega la interfaz NKRO al final
+static uint8_t* nkroConfigDescriptor(uint8_t* base, uint16_t* length) {
+  uint16_t baseLength = *length;
+  if(base == 0 || baseLength + NKRO_INTERFACE_DESC_SIZE > sizeof(nkroConfigDesc)) {
+    return base;
+  }
+
+  memcpy(nkroConfigDesc, base, baseLength);
+  nkroInterface = nkroConfigDesc[4];          // bNumInterfaces del core
+
+  uint8_t* d = nkroConfigDesc + baseLength;
+  const uint8_t interfaceDesc[9] = {
+    0x09, USB_DESC_TYPE_INTERFACE, nkroInterface, 0x00,
+    0x01,                           // Un endpoint
+    0x03, 0x00, 0x00,               // HID, sin subclase de arranque
+    0x00
+  };
+  const uint8_t endpointDesc[7] = {
+    0x07, USB_DESC_TYPE_ENDPOINT, NKRO_EPIN_ADDR,
+    0x03,                           // Interrupción
+    NKRO_REPORT_SIZE, 0x00,
+    NKRO_POLL_MS
+  };
+  memcpy(d, interfaceDesc, sizeof(interfaceDesc));
+  memcpy(d + 9, nkroHidDescriptor, sizeof(nkroHidDescriptor));
+  memcpy(d + 18, endpointDesc, sizeof(endpointDesc));
+
+  uint16_t total = baseLength + NKRO_INTERFACE_DESC_SIZE;
+  nkroConfigDesc[2] = LOBYTE(total);
+  nkroConfigDesc[3] = HIBYTE(total);
+  nkroConfigDesc[4] = nkroInterface + 1;
+
+  *length = total;
+  return nkroConfigDesc;
+}
+
+static uint8_t* nkroGetFSConfig(uint16_t* length) {
+  return nkroConfigDescriptor(USBD_COMPOSITE_HID.GetFSConfigDescriptor(length), length);
+}
+
+static uint8_t* nkroGetHSConfig(uint16_t* length) {
+  return nkroConfigDescriptor(USBD_COMPOSITE_HID.GetHSConfigDescriptor(length), length);
+}
+
+static uint8_t* nkroGetOtherSpeedConfig(uint16_t* length) {
+  return nkroConfigDescriptor(USBD_COMPOSITE_HID.GetOtherSpeedConfigDescriptor(length), length);
+}
+
+static uint8_t nkroInit(USBD_HandleTypeDef* pdev, uint8_t cfgidx) {
+  uint8_t status = USBD_COMPOSITE_HID.Init(pdev, cfgidx);
+  if(status != USBD_OK) return status;
+
+  #if defined(USB)
+  // El core solo reserva memoria de paquetes para sus propios endpoints
+  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData, NKRO_EPIN_ADDR, PCD_SNG_BUF, NKRO_PMA_ADDR);
+  #endif
+  USBD_LL_OpenEP(pdev, NKRO_EPIN_ADDR, USBD_EP_TYPE_INTR, NKRO_REPORT_SIZE);
+
+  nkroBusy = false;
+  nkroPending = false;
+  bootProtocol = false;
+  nkroConfigured = true;
+  return USBD_OK;
+}
+
+static uint8_t nkroDeInit(USBD_HandleTypeDef* pdev, uint8_t cfgidx) {
+  nkroConfigured = false;
+  USBD_LL_CloseEP(pdev, NKRO_EPIN_ADDR);
+  return USBD_COMPOSITE_HID.DeInit(pdev, cfgidx);
+}
+
+static uint8_t nkroSetup(USBD_HandleTypeDef* pdev, USBD_SetupReqTypedef* req) {
+  uint8_t type = req->bmRequest & USB_REQ_TYPE_MASK;
+  bool toNkro = (req->bmRequest & USB_REQ_RECIPIENT_MASK) == USB_REQ_RECIPIENT_INTERFACE &&
+                LOBYTE(req->wIndex) == nkroInterface;
+
+  if(!toNkro) {
+    // El protocolo que el host elige para el teclado de arranque decide si
+    // la interfaz NKRO está en uso
+    if(type == USB_REQ_TYPE_CLASS && req->bRequest == NKRO_REQ_SET_PROTOCOL &&
+       LOBYTE(req->wIndex) == HID_KEYBOARD_INTERFACE) {
+      bootProtocol = LOBYTE(req->wValue) == 0;
+    }
+    return USBD_COMPOSITE_HID.Setup(pdev, req);
+  }
+
+  static uint8_t alternate = 0;
+  static uint8_t status[2] = {0, 0};
+
+  if(type == USB_REQ_TYPE_CLASS) {
+    switch(req->bRequest) {
+      case NKRO_REQ_SET_IDLE:
+        nkroIdle = HIBYTE(req->wValue);
+        return USBD_OK;
+
+      case NKRO_REQ_GET_IDLE:
+        USBD_CtlSendData(pdev, &nkroIdle, 1);
+        return USBD_OK;
+
+      case NKRO_REQ_SET_PROTOCOL:
+        nkroProtocol = LOBYTE(req->wValue);
+        return USBD_OK;
+
+      case NKRO_REQ_GET_PROTOCOL:
+        USBD_CtlSendData(pdev, &nkroProtocol, 1);
+        return USBD_OK;
+    }
+  } else if(type == USB_REQ_TYPE_STANDARD) {
+    switch(req->bRequest) {
+      case USB_REQ_GET_DESCRIPTOR:
+        if(HIBYTE(req->wValue) == NKRO_DESC_REPORT) {
+          uint16_t len = sizeof(NKRO_REPORT_DESCRIPTOR);
+          USBD_CtlSendData(pdev, (uint8_t*)NKRO_REPORT_DESCRIPTOR, req->wLength < len ? req->wLength : len);
+          return USBD_OK;
+        }
+        if(HIBYTE(req->wValue) == NKRO_DESC_HID) {
+          uint16_t len = sizeof(nkroHidDescriptor);
+          USBD_CtlSendData(pdev, nkroHidDescriptor, req->wLength < len ? req->wLength : len);
+          return USBD_OK;
+        }
+        break;
+
+      case USB_REQ_GET_STATUS:
+        USBD_CtlSendData(pdev, status, 2);
+        return USBD_OK;
+
+      case USB_REQ_GET_INTERFACE:
+        USBD_CtlSendData(pdev, &alternate, 1);
+        return USBD_OK;
+
+      case USB_REQ_SET_INTERFACE:
+        return USBD_OK;
+    }
+  }
+
+  USBD_CtlError(pdev, req);
+  return USBD_FAIL;
+}
+
+static uint8_t nkroDataIn(USBD_HandleTypeDef* pdev, uint8_t epnum) {
+  if(epnum != (NKRO_EPIN_ADDR & 0x7F)) {
+    return USBD_COMPOSITE_HID.DataIn(pdev, epnum);
+  }
+
+  // Un reporte que llegó con el endpoint ocupado sale ahora
+  if(nkroPending) {
+    nkroPending = false;
+    nkroBusySince = millis();
+    USBD_LL_Transmit(pdev, NKRO_EPIN_ADDR, nkroReport, NKRO_REPORT_SIZE);
+  } else {
+    nkroBusy = false;
+  }
+  return USBD_OK;
+}
+
+// Reemplaza a Keyboard.begin(): mismo dispositivo con la interfaz NKRO
+void HID_NKRO_begin() {
+  nkroClass = USBD_COMPOSITE_HID;
+  nkroClass.Init = nkroInit;
+  nkroClass.DeInit = nkroDeInit;
+  nkroClass.Setup = nkroSetup;
+  nkroClass.DataIn = nkroDataIn;
+  nkroClass.GetHSConfigDescriptor = nkroGetHSConfig;
+  nkroClass.GetFSConfigDescriptor = nkroGetFSConfig;
+  nkroClass.GetOtherSpeedConfigDescriptor = nkroGetOtherSpeedConfig;
+
+  if(USBD_Init(&hUSBD_Device_HID, &USBD_Desc, 0) != USBD_OK) return;
+  if(USBD_RegisterClass(&hUSBD_Device_HID, &nkroClass) != USBD_OK) return;
+  USBD_Start(&hUSBD_Device_HID);
+}
+
+bool HID_NKRO_sendReport(uint8_t* report, uint16_t len) {
+  if(!nkroConfigured || bootProtocol || len != NKRO_REPORT_SIZE ||
+     hUSBD_Device_HID.dev_state != USBD_STATE_CONFIGURED) {
+    return false;
+  }
+
+  bool accepted = true;
+  noInterrupts();
+  memcpy(nkroReport, report, NKRO_REPORT_SIZE);
+  if(nkroBusy) {
+    // Sale al liberarse el endpoint; si el host no lo recoge, no la usa
+    nkroPending = true;
+    accepted = millis() - nkroBusySince < NKRO_STALL_MS;
+  } else {
+    nkroBusy = true;
+    nkroBusySince = millis();
+    USBD_LL_Transmit(&hUSBD_Device_HID, NKRO_EPIN_ADDR, nkroReport, NKRO_REPORT_SIZE);
+  }
+  interrupts();
+  return accepted;
+}
+
+#else
+
+// ============= SIN USB DEL CORE =============
+// Sin la interfaz (simulador u otro core) el dispositivo es el de la
+// librería Keyboard y el transporte NKRO no está disponible: el motor vuelve
+// al reporte de arranque. sim/Keyboard.cpp define su propia versión.
+#include <Keyboard.h>
+
+__attribute__((weak)) void HID_NKRO_begin() {
+  Keyboard.begin();
+}
+
+__attribute__((weak)) bool HID_NKRO_sendReport(uint8_t* report, uint16_t len) {
+  (void)report;
+  (void)len;
+  return false;
+}
+
+#endif
@@ -0,0 +1,392 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <Keyboard.h>
+#include <usbd_hid_composite_if.h>
+#include "config.h"
+
+// ============= CONFIGURACIÓN DEL REPORTE HID =============
+#define HID_REPORT_SIZE 8           // Reporte de arranque: mods, reservado, 6 teclas
+#define HID_MAX_KEYS 6
+#define HID_USAGE_ERROR_ROLLOVER 0x01
+#define HID_MOD_LEFT_SHIFT 0x02
+#define HID_ASCII_SHIFT 0x80
+
+#define HID_NKRO_BITMAP_BYTES 16    // Usages 0x00-0x7F, un bit por tecla
+#define HID_NKRO_REPORT_SIZE (1 + HID_NKRO_BITMAP_BYTES)
+
+// Transporte NKRO: reporte de HID_NKRO_REPORT_SIZE bytes, un byte de
+// modificadores (E0-E7) y un bitmap de usages 0x00-0x7F. HID_NKRO_begin()
+// reemplaza a Keyboard.begin() y registra el HID compuesto del core con una
+// interfaz más para ese reporte (report.cpp). HID_NKRO_sendReport() devuelve
+// false mientras el host use el protocolo de arranque o no recoja la
+// interfaz, y el motor vuelve al reporte de 6 teclas.
+void HID_NKRO_begin();
+bool HID_NKRO_sendReport(uint8_t* report, uint16_t len);
+
+// Tabla ASCII -> usage HID (distribución US), igual a la de la librería
+// Keyboard. El bit HID_ASCII_SHIFT indica que requiere Shift.
+const uint8_t KEY_ASCII_USAGE[128] = {
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x2a, 0x2b, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x2c, 0x9e, 0xb4, 0xa0, 0xa1, 0xa2, 0xa4, 0x34,   //  !"#$%&'
+  0xa6, 0xa7, 0xa5, 0xae, 0x36, 0x2d, 0x37, 0x38,   // ()*+,-./
+  0x27, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24,   // 01234567
+  0x25, 0x26, 0xb3, 0x33, 0xb6, 0x2e, 0xb7, 0xb8,   // 89:;<=>?
+  0x9f, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a,   // @ABCDEFG
+  0x8b, 0x8c, 0x8d, 0x8e, 0x8f, 0x90, 0x91, 0x92,   // HIJKLMNO
+  0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a,   // PQRSTUVW
+  0x9b, 0x9c, 0x9d, 0x2f, 0x31, 0x30, 0xa3, 0xad,   // XYZ[\]^_
+  0x35, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a,   // `abcdefg
+  0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12,   // hijklmno
+  0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a,   // pqrstuvw
+  0x1b, 0x1c, 0x1d, 0xaf, 0xb1, 0xb0, 0xb5, 0x00    // xyz{|}~
+};
+
+// Traducir keycode estilo Arduino a usage HID y bits de modificador
+inline uint8_t keycodeToUsage(uint8_t keycode, uint8_t* modifiers) {
+  if(keycode >= 136) {
+    return keycode - 136;             // Teclas no imprimibles (F1, flechas...)
+  }
+  if(keycode >= 128) {
+    *modifiers |= (1 << (keycode - 128));
+    return 0;                         // Modificador puro
+  }
+
+  uint8_t usage = KEY_ASCII_USAGE[keycode];
+  if(usage & HID_ASCII_SHIFT) {
+    *modifiers |= HID_MOD_LEFT_SHIFT;
+    usage &= ~HID_ASCII_SHIFT;
+  }
+  return usage;
+}
+
+// ============= MOTOR DE REPORTES POR DIFERENCIA DE ESTADO =============
+// Mantiene el conjunto de teclas deseado (botones mantenidos según
+// GroupDebounce + la tecla en vuelo del transmisor) y envía un reporte
+// solo cuando ese conjunto cambia. Varias pulsaciones en el mismo escaneo
+// salen en un único reporte, y mantener un botón mantiene la tecla.
+//
+// El código de cada botón sale de la tabla de setKeymap() (los códigos
+// fijados al presionar en layers.h); sin tabla, de BUTTON_MAP.
+//
+// En modo NKRO el reporte es un bitmap con el estado completo de los
+// botones, sin límite de 6 teclas. Si el transporte NKRO rechaza un
+// reporte se vuelve al modo de arranque hasta el próximo setNkro(true).
+//
+// Si la tecla del transmisor ya está mantenida por un botón o una macro,
+// sumarla no cambiaría el reporte y el host no vería la pulsación: antes
+// sale un reporte que la suelta, y la tecla vuelve en el siguiente.
+//
+// Un botón que interrumpe algo todavía sin enviar se difiere: entra en el
+// reporte siguiente al próximo (deferButtons, p. ej. tras una tecla
+// retenida que sale por la interrupción) o al que lleva la próxima tecla
+// del transmisor (deferButtonsToTap, tras un toque de tap dance en cola).
+// Así el host ve lo interrumpido antes que la tecla que lo decidió.
+class HidReportEngine {
+private:
+  uint16_t buttonMask;      // Botones que deben verse presionados
+  uint16_t deferredButtons; // De buttonMask, los que esperan un reporte aparte
+  bool deferToTap;          // ... que además lleve la próxima tecla del transmisor
+  const uint8_t* keymap;    // Código por botón (0 = usar BUTTON_MAP)
+  const uint8_t* macroKeys; // Teclas mantenidas por una macro
+  uint8_t macroKeyCount;
+  uint8_t tapKey;           // Tecla temporal del transmisor (0 = ninguna)
+  bool tapEdgePending;      // tapKey recién puesta: falta ver si ya estaba mantenida
+  bool tapUnsent;           // tapKey todavía no salió en un reporte
+  uint8_t releaseUsage;     // Usage que el próximo reporte deja fuera (0 = ninguno)
+  uint8_t lastReport[HID_NKRO_REPORT_SIZE];
+  uint8_t lastReportSize;
+  bool nkro;
+  bool releaseOther;        // Soltar las teclas en la interfaz que se dejó
+  bool dirty;
+  unsigned long lastSendTime;
+
+  // Estadísticas
+  unsigned long reportsSent;
+  unsigned long rolloverReports;
+  unsigned long nkroFallbacks;
+
+  void addKey(uint8_t keycode, uint8_t* report, uint8_t* count, bool* overflow) {
+    uint8_t usage = keycodeToUsage(keycode, &report[0]);
+    if(usage == 0 || usage == releaseUsage) return;
+
+    for(uint8_t i = 0; i < *count; i++) {
+      if(report[2 + i] == usage) return;
+    }
+
+    if(*count >= HID_MAX_KEYS) {
+      *overflow = true;
+      return;
+    }
+
+    report[2 + (*count)++] = usage;
+  }
+
+  uint8_t buttonKeycode(uint8_t button) {
+    return keymap ? keymap[button] : BUTTON_MAP[button].keycode;
+  }
+
+  void addBit(uint8_t keycode, uint8_t* report) {
+    uint8_t usage = keycodeToUsage(keycode, &report[0]);
+    if(usage == 0 || usage == releaseUsage || usage >= HID_NKRO_BITMAP_BYTES * 8) return;
+
+    report[1 + (usage >> 3)] |= (1 << (usage & 7));
+  }
+
+  // Usage presente por un botón o una tecla de macro
+  bool isHeld(uint8_t usage) {
+    uint8_t modifiers = 0;
+    uint16_t buttons = buttonMask & ~deferredButtons;
+
+    for(uint8_t i = 0; i < 16; i++) {
+      if((buttons & (1 << i)) && keycodeToUsage(buttonKeycode(i), &modifiers) == usage) {
+        return true;
+      }
+    }
+
+    for(uint8_t i = 0; i < macroKeyCount; i++) {
+      if(keycodeToUsage(macroKeys[i], &modifiers) == usage) return true;
+    }
+    return false;
+  }
+
+  void buildNkroReport(uint8_t* report) {
+    memset(report, 0, HID_NKRO_REPORT_SIZE);
+    uint16_t buttons = buttonMask & ~deferredButtons;
+
+    for(uint8_t i = 0; i < 16; i++) {
+      if(buttons & (1 << i)) {
+        addBit(buttonKeycode(i), report);
+      }
+    }
+
+    for(uint8_t i = 0; i < macroKeyCount; i++) {
+      addBit(macroKeys[i], report);
+    }
+
+    if(tapKey != 0) {
+      addBit(tapKey, report);
+    }
+  }
+
+  void buildReport(uint8_t* report) {
+    memset(report, 0, HID_REPORT_SIZE);
+
+    uint8_t count = 0;
+    bool overflow = false;
+    uint16_t buttons = buttonMask & ~deferredButtons;
+
+    for(uint8_t i = 0; i < 16; i++) {
+      if(buttons & (1 << i)) {
+        addKey(buttonKeycode(i), report, &count, &overflow);
+      }
+    }
+
+    for(uint8_t i = 0; i < macroKeyCount; i++) {
+      addKey(macroKeys[i], report, &count, &overflow);
+    }
+
+    if(tapKey != 0) {
+      addKey(tapKey, report, &count, &overflow);
+    }
+
+    // Más de 6 teclas: el estándar pide ErrorRollOver en todas las posiciones
+    if(overflow) {
+      for(uint8_t i = 0; i < HID_MAX_KEYS; i++) {
+        report[2 + i] = HID_USAGE_ERROR_ROLLOVER;
+      }
+    }
+  }
+
+  // El reporte recién armado ya está en el host (enviado o igual al
+  // anterior): los botones diferidos van en el siguiente
+  void reportShown(bool withTap) {
+    if(withTap) tapUnsent = false;
+    if(deferredButtons && (withTap || !deferToTap)) {
+      deferredButtons = 0;
+      deferToTap = false;
+      dirty = true;
+    }
+  }
+
+public:
+  HidReportEngine() :
+    buttonMask(0),
+    deferredButtons(0),
+    deferToTap(false),
+    keymap(0),
+    macroKeys(0),
+    macroKeyCount(0),
+    tapKey(0),
+    tapEdgePending(false),
+    tapUnsent(false),
+    releaseUsage(0),
+    lastReportSize(HID_REPORT_SIZE),
+    nkro(HID_NKRO_ENABLED),
+    releaseOther(false),
+    dirty(false),
+    lastSendTime(0),
+    reportsSent(0),
+    rolloverReports(0),
+    nkroFallbacks(0) {
+    memset(lastReport, 0, sizeof(lastReport));
+  }
+
+  // Cambiar entre bitmap NKRO y reporte de arranque en tiempo de ejecución.
+  // El host ve las dos interfaces: las teclas que quedaron en la anterior se
+  // sueltan un poll después del primer reporte en la nueva
+  void setNkro(bool enabled) {
+    if(enabled != nkro) {
+      for(uint8_t i = 0; i < lastReportSize; i++) {
+        if(lastReport[i] != 0) releaseOther = true;
+      }
+      nkro = enabled;
+      lastReportSize = 0;   // Forzar reenvío completo en el nuevo formato
+      dirty = true;
+    }
+  }
+
+  bool isNkro() {
+    return nkro;
+  }
+
+  void setKeymap(const uint8_t* keycodes) {
+    keymap = keycodes;
+    dirty = true;
+  }
+
+  void setButtons(uint16_t mask) {
+    deferredButtons &= mask;
+    if(!deferredButtons) deferToTap = false;
+    if(mask != buttonMask) {
+      buttonMask = mask;
+      dirty = true;
+    }
+  }
+
+  // Estos botones (ya presionados o por presionar) no entran al reporte
+  // hasta el siguiente al próximo
+  void deferButtons(uint16_t mask) {
+    deferredButtons |= mask;
+  }
+
+  // ... o hasta el siguiente al que lleve la próxima tecla del transmisor
+  void deferButtonsToTap(uint16_t mask) {
+    deferredButtons |= mask;
+    deferToTap = true;
+  }
+
+  // Cambió el código de un botón ya presionado (tap-hold resuelto)
+  void keymapChanged() {
+    dirty = true;
+  }
+
+  // Teclas que mantiene el reproductor de macros; llamar en cada cambio
+  void setMacroKeys(const uint8_t* keys, uint8_t count) {
+    macroKeys = keys;
+    macroKeyCount = count;
+    dirty = true;
+  }
+
+  void setTapKey(uint8_t keycode) {
+    if(keycode != tapKey) {
+      tapKey = keycode;
+      tapEdgePending = keycode != 0;
+      tapUnsent = keycode != 0;
+      dirty = true;
+    }
+  }
+
+  // Enviar el reporte si el conjunto cambió; respeta el intervalo de poll
+  // del host para no perder reportes con el endpoint ocupado
+  bool flush() {
+    if(!dirty) return false;
+    if(micros() - lastSendTime < USB_POLL_INTERVAL * 1000UL) return false;
+
+    if(releaseOther && lastReportSize != 0) {
+      uint8_t empty[HID_NKRO_REPORT_SIZE];
+      memset(empty, 0, sizeof(empty));
+      if(nkro) {
+        HID_Composite_keyboard_sendReport(empty, HID_REPORT_SIZE);
+      } else {
+        HID_NKRO_sendReport(empty, HID_NKRO_REPORT_SIZE);
+      }
+      releaseOther = false;
+      lastSendTime = micros();
+      return false;
+    }
+
+    if(tapEdgePending) {
+      tapEdgePending = false;
+      uint8_t modifiers = 0;
+      uint8_t usage = keycodeToUsage(tapKey, &modifiers);
+      if(usage != 0 && isHeld(usage)) {
+        releaseUsage = usage;
+      }
+    }
+
+    uint8_t report[HID_NKRO_REPORT_SIZE];
+    uint8_t size = nkro ? HID_NKRO_REPORT_SIZE : HID_REPORT_SIZE;
+
+    if(nkro) {
+      buildNkroReport(report);
+    } else {
+      buildReport(report);
+    }
+    dirty = false;
+    bool withTap = tapUnsent && releaseUsage == 0;
+
+    if(size == lastReportSize && memcmp(report, lastReport, size) == 0) {
+      releaseUsage = 0;
+      reportShown(withTap);
+      return false;
+    }
+
+    if(nkro && !HID_NKRO_sendReport(report, size)) {
+      // Host en protocolo de arranque o core sin interfaz NKRO
+      nkro = false;
+      releaseOther = false;   // Se sigue en la interfaz de arranque
+      nkroFallbacks++;
+      size = HID_REPORT_SIZE;
+      buildReport(report);
+    }
+
+    if(!nkro) {
+      HID_Composite_keyboard_sendReport(report, size);
+    }
+
+    memcpy(lastReport, report, size);
+    lastReportSize = size;
+    lastSendTime = micros();
+    reportShown(withTap);
+
+    // Tras el reporte de liberación la tecla vuelve en el siguiente poll
+    if(releaseUsage != 0) {
+      releaseUsage = 0;
+      dirty = true;
+    }
+    if(releaseOther) dirty = true;
+
+    reportsSent++;
+    if(!nkro && report[2] == HID_USAGE_ERROR_ROLLOVER) {
+      rolloverReports++;
+    }
+    return true;
+  }
+
+  // Hay un cambio pendiente de enviar
+  bool isPending() {
+    return dirty;
+  }
+
+  void getStats(unsigned long* sent, unsigned long* rollovers, unsigned long* fallbacks) {
+    *sent = reportsSent;
+    *rollovers = rolloverReports;
+    *fallbacks = nkroFallbacks;
+  }
+};
+
+#endif
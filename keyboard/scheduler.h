@@ -0,0 +1,151 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// ============= PLANIFICADOR COOPERATIVO DE TAREAS =============
+// Tabla estática de tareas a tasa fija. Cada tarea tiene:
+//   period   - us entre liberaciones (0 = en cada pasada de loop())
+//   priority - 0 = máxima; entre tareas listas en la misma pasada corre
+//              primero la de mayor prioridad
+//   deadline - retraso máximo tolerado (us) entre la liberación y el inicio
+// Las liberaciones van en fase fija (next += period), así que un retraso
+// no se acumula. Si una tarea se atrasa más de un periodo, las
+// liberaciones saltadas cuentan como plazos perdidos y se recupera la fase
+// sin ejecuciones en ráfaga. Nadie expropia a nadie: una tarea lenta
+// retrasa a las demás, pero el jitter y los plazos perdidos lo hacen visible.
+typedef void (*TaskFunction)(void);
+
+struct Task {
+  const char* name;
+  TaskFunction run;
+  unsigned long period;       // us (0 = cada pasada)
+  uint8_t priority;           // 0 = máxima
+  unsigned long deadline;     // us de retraso tolerado
+
+  // Estado y estadísticas (los inicializa el planificador)
+  unsigned long nextRelease;
+  unsigned long runs;
+  unsigned long misses;
+  unsigned long maxJitter;    // Mayor retraso de inicio (us)
+  unsigned long totalJitter;
+  unsigned long maxRunTime;   // Mayor duración de una ejecución (us)
+};
+
+// Entrada de la tabla: nombre, función, periodo, prioridad, plazo
+#define TASK(name, fn, period, priority, deadline) \
+  {name, fn, period, priority, deadline, 0, 0, 0, 0, 0, 0}
+
+#define SCHEDULER_MAX_TASKS 12
+
+class TaskScheduler {
+private:
+  Task* tasks;
+  uint8_t taskCount;
+  uint8_t order[SCHEDULER_MAX_TASKS];   // Índices por prioridad
+
+public:
+  TaskScheduler(Task* table, uint8_t count) :
+    tasks(table),
+    taskCount(count > SCHEDULER_MAX_TASKS ? SCHEDULER_MAX_TASKS : count) {}
+
+  // Ordenar por prioridad (estable) y fijar la primera liberación
+  void begin() {
+    unsigned long now = micros();
+
+    for(uint8_t i = 0; i < taskCount; i++) {
+      uint8_t j = i;
+      while(j > 0 && tasks[order[j - 1]].priority > tasks[i].priority) {
+        order[j] = order[j - 1];
+        j--;
+      }
+      order[j] = i;
+
+      tasks[i].nextRelease = now + tasks[i].period;
+    }
+
+    resetStats();
+  }
+
+  // Ejecutar una vez cada tarea liberada, en orden de prioridad
+  void run() {
+    for(uint8_t k = 0; k < taskCount; k++) {
+      Task& t = tasks[order[k]];
+      unsigned long start = micros();
+
+      if(t.period > 0) {
+        long late = (long)(start - t.nextRelease);
+        if(late < 0) continue;
+
+        unsigned long jitter = (unsigned long)late;
+        if(jitter > t.maxJitter) t.maxJitter = jitter;
+        t.totalJitter += jitter;
+        if(jitter > t.deadline) t.misses++;
+
+        // Liberaciones que ya pasaron enteras: perdidas, no se recuperan
+        unsigned long skipped = jitter / t.period;
+        t.misses += skipped;
+        t.nextRelease += (skipped + 1) * t.period;
+      }
+
+      t.run();
+      t.runs++;
+
+      unsigned long elapsed = micros() - start;
+      if(elapsed > t.maxRunTime) t.maxRunTime = elapsed;
+    }
+  }
+
+  void resetStats() {
+    for(uint8_t i = 0; i < taskCount; i++) {
+      tasks[i].runs = 0;
+      tasks[i].misses = 0;
+      tasks[i].maxJitter = 0;
+      tasks[i].totalJitter = 0;
+      tasks[i].maxRunTime = 0;
+    }
+  }
+
+  void getStats(uint8_t index, unsigned long* runs, unsigned long* misses,
+                unsigned long* meanJitter, unsigned long* maxJitter) {
+    Task& t = tasks[index];
+    *runs = t.runs;
+    *misses = t.misses;
+    *meanJitter = t.runs ? t.totalJitter / t.runs : 0;
+    *maxJitter = t.maxJitter;
+  }
+
+  void printStats() {
+    Serial.println("=== TAREAS ===");
+    for(uint8_t k = 0; k < taskCount; k++) {
+      Task& t = tasks[order[k]];
+      unsigned long runs, misses, meanJitter, maxJitter;
+      getStats(order[k], &runs, &misses, &meanJitter, &maxJitter);
+
+      Serial.print(t.name);
+      Serial.print(" [");
+      if(t.period > 0) {
+        Serial.print(t.period);
+        Serial.print("us");
+      } else {
+        Serial.print("cada pasada");
+      }
+      Serial.print(", P");
+      Serial.print(t.priority);
+      Serial.print("]: n=");
+      Serial.print(runs);
+      Serial.print(" jitter media=");
+      Serial.print(meanJitter);
+      Serial.print(" max=");
+      Serial.print(maxJitter);
+      Serial.print("us, plazos perdidos=");
+      Serial.print(misses);
+      Serial.print(", ejecucion max=");
+      Serial.print(t.maxRunTime);
+      Serial.println("us");
+    }
+  }
+};
+
+#endif
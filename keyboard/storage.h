@@ -3,34 +3,79 @@
 
 #include <EEPROM.h>
 #include "config.h"
+#include "keycodes.h"
+#include "journal.h"
 
 // ============= CONFIGURACIÓN DE ALMACENAMIENTO =============
-#define STORAGE_VERSION 0x01        // Versión del formato de almacenamiento
+#define STORAGE_VERSION 0x02        // Versión del formato de almacenamiento
+#define STORAGE_LEGACY_VERSION 0x01 // Un solo mapeo, en EEPROM
 #define STORAGE_MAGIC 0xBEEF        // Número mágico para validación
-#define STORAGE_START_ADDR 0        // Dirección inicial en EEPROM
+#define STORAGE_START_ADDR 0        // Dirección en EEPROM del formato anterior
+
+// Diario en flash: páginas 60-61 del STM32F103C8 (58-59 son de las macros,
+// la 63 de la EEPROM emulada del core). Si el sketch crece hasta ahí, el
+// diario se deshabilita al arrancar (FlashJournal::begin()).
+#define STORAGE_JOURNAL_ADDR (FLASH_BASE + 60 * FLASH_PAGE_SIZE)
+#define STORAGE_JOURNAL_PAGES 2
+#define STORAGE_IDLE_SAVE_MS 2000   // Guardar tras este tiempo sin cambios
+
+static_assert(STORAGE_JOURNAL_PAGES >= 2, "El diario rota entre al menos dos paginas");
+
+// Mapeo de un perfil
+struct ProfileData {
+  uint8_t keycodes[16];             // Mapeo de las 16 teclas
+  uint8_t encoderAKeys[2];          // Izq/Der encoder A
+  uint8_t encoderBKeys[2];          // Izq/Der encoder B
+};
 
 // Estructura para almacenar la configuración
 struct StorageData {
   uint16_t magic;                   // Validación de datos
   uint8_t version;                  // Versión del formato
-  uint8_t keycodes[16];             // Mapeo de las 16 teclas
-  uint8_t encoderAKeys[2];          // Izq/Der encoder A
-  uint8_t encoderBKeys[2];          // Izq/Der encoder B
-  uint8_t checksum;                 // Checksum simple
+  uint8_t activeProfile;            // Perfil en uso al guardar
+  ProfileData profiles[PROFILE_COUNT];
+  uint8_t reserved;
+  uint8_t checksum;                 // Checksum simple, siempre al final
+};
+
+static_assert(sizeof(StorageData) == offsetof(StorageData, checksum) + 1, "Sin relleno tras el checksum");
+
+// Formato 0x01 en EEPROM, un solo mapeo (solo para migrar)
+struct LegacyStorageData {
+  uint16_t magic;
+  uint8_t version;
+  ProfileData profile;
+  uint8_t checksum;
 };
 
+FlashJournal<StorageData> configJournal(STORAGE_JOURNAL_ADDR, STORAGE_JOURNAL_PAGES);
+
+// Todos los perfiles en RAM. El activo además está copiado en BUTTON_MAP y
+// ENCODER_MAP, que es lo que leen el escaneo y los reportes: cambiar de
+// perfil copia 20 bytes y nunca lee flash.
+ProfileData profiles[PROFILE_COUNT];
+uint8_t activeProfile = 0;
+
+// Cambia con cada modificación de BUTTON_MAP/ENCODER_MAP, para que quien
+// guarde tablas derivadas (layers.h) sepa cuándo rehacerlas
+uint8_t mappingGeneration = 0;
+
+// Cambios pendientes de escribir (ver scheduleConfigurationSave)
+bool storagePending = false;
+unsigned long storagePendingSince = 0;
+unsigned long storageSkipped = 0;   // Guardados evitados: igual al último registro
+
 // ============= FUNCIONES DE ALMACENAMIENTO =============
 
-// Calcular checksum
-uint8_t calculateChecksum(StorageData* data) {
+// Calcular checksum de los bytes previos al checksum
+uint8_t calculateChecksum(const void* data, size_t length) {
   uint8_t sum = 0;
-  uint8_t* ptr = (uint8_t*)data;
-  
-  // Sumar todos los bytes excepto el checksum mismo
-  for(size_t i = 0; i < sizeof(StorageData) - 1; i++) {
+  const uint8_t* ptr = (const uint8_t*)data;
+
+  for(size_t i = 0; i < length; i++) {
     sum += ptr[i];
   }
-  
+
   return ~sum;  // Complemento a 1
 }
 
@@ -42,12 +87,12 @@ bool validateStorage(StorageData* data) {
   }
   
   // Verificar versión
-  if(data->version != STORAGE_VERSION) {
+  if(data->version != STORAGE_VERSION || data->activeProfile >= PROFILE_COUNT) {
     return false;
   }
   
   // Verificar checksum
-  uint8_t calculated = calculateChecksum(data);
+  uint8_t calculated = calculateChecksum(data, offsetof(StorageData, checksum));
   if(calculated != data->checksum) {
     return false;
   }
@@ -55,61 +100,137 @@ bool validateStorage(StorageData* data) {
   return true;
 }
 
-// Guardar configuración actual en EEPROM
+bool validateLegacyStorage(LegacyStorageData* data) {
+  return data->magic == STORAGE_MAGIC &&
+         data->version == STORAGE_LEGACY_VERSION &&
+         data->checksum == calculateChecksum(data, offsetof(LegacyStorageData, checksum));
+}
+
+// Copiar el mapeo en uso a un perfil
+void captureProfile(ProfileData* profile) {
+  for(int i = 0; i < 16; i++) {
+    profile->keycodes[i] = BUTTON_MAP[i].keycode;
+  }
+
+  profile->encoderAKeys[0] = ENCODER_MAP[0].left_key;
+  profile->encoderAKeys[1] = ENCODER_MAP[0].right_key;
+  profile->encoderBKeys[0] = ENCODER_MAP[1].left_key;
+  profile->encoderBKeys[1] = ENCODER_MAP[1].right_key;
+}
+
+void markMappingChanged() {
+  mappingGeneration++;
+}
+
+// Poner un perfil en uso; port/pin/description no cambian
+void applyProfile(const ProfileData* profile) {
+  markMappingChanged();
+
+  for(int i = 0; i < 16; i++) {
+    BUTTON_MAP[i].keycode = profile->keycodes[i];
+  }
+
+  ENCODER_MAP[0].left_key = profile->encoderAKeys[0];
+  ENCODER_MAP[0].right_key = profile->encoderAKeys[1];
+  ENCODER_MAP[1].left_key = profile->encoderBKeys[0];
+  ENCODER_MAP[1].right_key = profile->encoderBKeys[1];
+}
+
+// Guardar configuración actual en el diario, ya
 void saveConfiguration() {
   StorageData data;
   
   // Preparar estructura
   data.magic = STORAGE_MAGIC;
   data.version = STORAGE_VERSION;
-  
-  // Copiar mapeo de botones
-  for(int i = 0; i < 16; i++) {
-    data.keycodes[i] = BUTTON_MAP[i].keycode;
-  }
-  
-  // Copiar mapeo de encoders
-  data.encoderAKeys[0] = ENCODER_MAP[0].left_key;
-  data.encoderAKeys[1] = ENCODER_MAP[0].right_key;
-  data.encoderBKeys[0] = ENCODER_MAP[1].left_key;
-  data.encoderBKeys[1] = ENCODER_MAP[1].right_key;
-  
+  data.activeProfile = activeProfile;
+  data.reserved = 0;
+
+  // Los remapeos del modo configuración están en BUTTON_MAP
+  captureProfile(&profiles[activeProfile]);
+  memcpy(data.profiles, profiles, sizeof(profiles));
+
   // Calcular y asignar checksum
-  data.checksum = calculateChecksum(&data);
-  
-  // Escribir en EEPROM
-  EEPROM.put(STORAGE_START_ADDR, data);
+  data.checksum = calculateChecksum(&data, offsetof(StorageData, checksum));
   
-  Serial.println("Configuracion guardada en EEPROM");
+  storagePending = false;
+
+  // Sin cambios respecto del último registro: no gastar flash
+  if(configJournal.matchesLatest(data)) {
+    storageSkipped++;
+    return;
+  }
+
+  if(configJournal.append(data)) {
+    Serial.println("Configuracion guardada en flash");
+  } else {
+    Serial.println("ERROR: no se pudo guardar la configuracion");
+  }
+}
+
+// Agrupar cambios: se escriben juntos al salir del modo configuración o
+// tras STORAGE_IDLE_SAVE_MS sin cambios nuevos
+void scheduleConfigurationSave() {
+  storagePending = true;
+  storagePendingSince = millis();
+}
+
+// Escribir ya los cambios pendientes, si los hay
+void flushConfiguration() {
+  if(storagePending) {
+    saveConfiguration();
+  }
+}
+
+// Llamar periódicamente
+void updateStorage() {
+  if(storagePending && millis() - storagePendingSince >= STORAGE_IDLE_SAVE_MS) {
+    saveConfiguration();
+  }
 }
 
-// Cargar configuración desde EEPROM
+// Cambiar de perfil. El índice activo se guarda con la escritura agrupada.
+bool selectProfile(uint8_t index) {
+  if(index >= PROFILE_COUNT) return false;
+  if(index == activeProfile) return true;
+
+  captureProfile(&profiles[activeProfile]);
+  activeProfile = index;
+  applyProfile(&profiles[index]);
+  scheduleConfigurationSave();
+  return true;
+}
+
+uint8_t getActiveProfile() {
+  return activeProfile;
+}
+
+// Cargar configuración: último registro del diario o, si está vacío, el
+// formato anterior en EEPROM como perfil 1
 bool loadConfiguration() {
   StorageData data;
-  
-  // Leer de EEPROM
-  EEPROM.get(STORAGE_START_ADDR, data);
-  
-  // Validar datos
-  if(!validateStorage(&data)) {
-    Serial.println("EEPROM sin datos validos o corrupta");
-    return false;
+  if(configJournal.read(&data) && validateStorage(&data)) {
+    memcpy(profiles, data.profiles, sizeof(profiles));
+    activeProfile = data.activeProfile;
+    applyProfile(&profiles[activeProfile]);
+    Serial.println("Configuracion cargada desde flash");
+    return true;
   }
-  
-  // Aplicar configuración a las estructuras en memoria
-  for(int i = 0; i < 16; i++) {
-    // Actualizar solo el keycode, mantener port/pin/description
-    const_cast<KeyMap*>(BUTTON_MAP)[i].keycode = data.keycodes[i];
+
+  LegacyStorageData legacy;
+  EEPROM.get(STORAGE_START_ADDR, legacy);
+  if(validateLegacyStorage(&legacy)) {
+    // Migrar al diario una sola vez
+    profiles[0] = legacy.profile;
+    activeProfile = 0;
+    applyProfile(&profiles[0]);
+    Serial.println("Configuracion cargada desde EEPROM");
+    saveConfiguration();
+    return true;
   }
-  
-  // Actualizar encoders
-  const_cast<EncoderMap*>(ENCODER_MAP)[0].left_key = data.encoderAKeys[0];
-  const_cast<EncoderMap*>(ENCODER_MAP)[0].right_key = data.encoderAKeys[1];
-  const_cast<EncoderMap*>(ENCODER_MAP)[1].left_key = data.encoderBKeys[0];
-  const_cast<EncoderMap*>(ENCODER_MAP)[1].right_key = data.encoderBKeys[1];
-  
-  Serial.println("Configuracion cargada desde EEPROM");
-  return true;
+
+  Serial.println("Flash sin datos validos o corrupta");
+  return false;
 }
 
 // Resetear a configuración por defecto
@@ -121,16 +242,23 @@ void resetToDefaults() {
   };
   
   for(int i = 0; i < 16; i++) {
-    const_cast<KeyMap*>(BUTTON_MAP)[i].keycode = DEFAULT_KEYCODES[i];
+    BUTTON_MAP[i].keycode = DEFAULT_KEYCODES[i];
   }
   
   // Restaurar encoders
-  const_cast<EncoderMap*>(ENCODER_MAP)[0].left_key = 'c';
-  const_cast<EncoderMap*>(ENCODER_MAP)[0].right_key = 'v';
-  const_cast<EncoderMap*>(ENCODER_MAP)[1].left_key = 'b';
-  const_cast<EncoderMap*>(ENCODER_MAP)[1].right_key = 'n';
+  ENCODER_MAP[0].left_key = 'c';
+  ENCODER_MAP[0].right_key = 'v';
+  ENCODER_MAP[1].left_key = 'b';
+  ENCODER_MAP[1].right_key = 'n';
+
+  markMappingChanged();
+
+  // Todos los perfiles vuelven al mismo mapeo
+  for(uint8_t p = 0; p < PROFILE_COUNT; p++) {
+    captureProfile(&profiles[p]);
+  }
   
-  // Guardar defaults en EEPROM
+  // Guardar defaults
   saveConfiguration();
   
   Serial.println("Configuracion restaurada a valores por defecto");
@@ -138,11 +266,19 @@ void resetToDefaults() {
 
 // Inicializar sistema de almacenamiento
 void initStorage() {
-  // STM32 Blue Pill no tiene EEPROM real, usa Flash emulada
-  // La librería EEPROM para STM32 maneja esto automáticamente
-  
+  // STM32 Blue Pill no tiene EEPROM real: la configuración va al diario
+  // en flash, que rota entre sus páginas en vez de borrar en cada byte
   Serial.println("Inicializando sistema de almacenamiento...");
-  
+  configJournal.begin();
+  if(!configJournal.isUsable()) {
+    Serial.println("ERROR: el firmware ocupa las paginas del diario; la configuracion no se guardara");
+  }
+
+  // Sin datos guardados, cada perfil arranca con el mapeo de config.h
+  for(uint8_t p = 0; p < PROFILE_COUNT; p++) {
+    captureProfile(&profiles[p]);
+  }
+
   // Intentar cargar configuración
   if(!loadConfiguration()) {
     Serial.println("Usando configuracion por defecto");
@@ -151,40 +287,66 @@ void initStorage() {
   }
 }
 
+// Debug: contadores del diario
+void printStorageStats() {
+  unsigned long writes, erases, errors;
+  configJournal.getStats(&writes, &erases, &errors);
+
+  Serial.print("Flash: ");
+  Serial.print(writes);
+  Serial.print(" registros, ");
+  Serial.print(erases);
+  Serial.print(" borrados (max pagina: ");
+  Serial.print(configJournal.getMaxPageErases());
+  Serial.print("), libres ");
+  Serial.print(configJournal.getFreeSlots());
+  Serial.print("/");
+  Serial.print(configJournal.getSlotsPerPage());
+  Serial.print(", evitados ");
+  Serial.print(storageSkipped);
+  Serial.print(", errores ");
+  Serial.print(errors);
+  Serial.println(storagePending ? " [pendiente]" : "");
+}
+
+// Caracteres entre comillas, teclas especiales por nombre y el resto en hex
+void printKeyName(uint8_t keycode) {
+  const KeyInfo& info = keyInfo(keycode);
+
+  if(info.name[0] == 0) {
+    Serial.print("0x");
+    Serial.print(keycode, HEX);
+  } else if(info.name[1] == 0) {
+    Serial.print("'");
+    Serial.print(info.name);
+    Serial.print("'");
+  } else {
+    Serial.print(info.name);
+  }
+}
+
 // Debug: mostrar configuración actual
 void printCurrentConfiguration() {
-  Serial.println("=== CONFIGURACION ACTUAL ===");
+  Serial.print("=== CONFIGURACION ACTUAL (perfil ");
+  Serial.print(activeProfile + 1);
+  Serial.println(") ===");
   
   for(int i = 0; i < 16; i++) {
     Serial.print("Boton ");
     Serial.print(i + 1);
     Serial.print(": ");
     
-    uint8_t keycode = BUTTON_MAP[i].keycode;
-    if(keycode >= 'a' && keycode <= 'z') {
-      Serial.print("'");
-      Serial.print((char)keycode);
-      Serial.println("'");
-    } else if(keycode >= KEY_F1 && keycode <= KEY_F12) {
-      Serial.print("F");
-      Serial.println((keycode - KEY_F1) + 1);
-    } else {
-      Serial.print("0x");
-      Serial.println(keycode, HEX);
-    }
+    printKeyName(BUTTON_MAP[i].keycode);
+    Serial.println();
   }
   
-  Serial.print("Encoder A: izq='");
-  Serial.print((char)ENCODER_MAP[0].left_key);
-  Serial.print("' der='");
-  Serial.print((char)ENCODER_MAP[0].right_key);
-  Serial.println("'");
-  
-  Serial.print("Encoder B: izq='");
-  Serial.print((char)ENCODER_MAP[1].left_key);
-  Serial.print("' der='");
-  Serial.print((char)ENCODER_MAP[1].right_key);
-  Serial.println("'");
+  for(int e = 0; e < 2; e++) {
+    Serial.print(e == 0 ? "Encoder A: izq=" : "Encoder B: izq=");
+    printKeyName(ENCODER_MAP[e].left_key);
+    Serial.print(" der=");
+    printKeyName(ENCODER_MAP[e].right_key);
+    Serial.println();
+  }
   
   Serial.println("========================");
 }
@@ -0,0 +1,225 @@
+#ifndef TAPDANCE_H
+#define TAPDANCE_H
+
+#include "config.h"
+
+// ============= TOQUE / MANTENER / MULTITOQUE =============
+// Estado por tecla para las teclas TD(n) de LAYER_KEYMAPS. Cada tecla
+// resuelve por su cuenta, a partir de los flancos y sus tiempos:
+//   - soltada antes de TAP_HOLD_TERM_MS: toque
+//   - mantenida TAP_HOLD_TERM_MS (u otra tecla presionada mientras tanto,
+//     con TAP_HOLD_ON_OTHER_KEY): mantener
+//   - tocada de nuevo antes de TAP_DANCE_TERM_MS: un toque más
+// El toque sale apenas no queda otra salida posible: al soltar si la tecla
+// no define más toques, o al vencer TAP_DANCE_TERM_MS. Una tecla con un
+// solo toque no espera nada después de soltarla.
+//
+// No lee el reloj: press/release/update reciben el tiempo en ms, así que
+// la misma secuencia de flancos da siempre el mismo resultado.
+
+enum TapDanceState {
+  TAP_DANCE_IDLE,
+  TAP_DANCE_PRESSED,      // Abajo, todavía sin decidir
+  TAP_DANCE_RELEASED,     // Arriba, esperando otro toque
+  TAP_DANCE_HELD          // Decidido: mantener hasta soltar
+};
+
+enum TapDanceEventType {
+  TAP_DANCE_TAP,          // count toques
+  TAP_DANCE_HOLD          // Empezó a mantenerse (tras count - 1 toques)
+};
+
+struct TapDanceEvent {
+  uint8_t type;
+  uint8_t button;
+  uint8_t dance;          // Índice en TAP_DANCES
+  uint8_t count;
+};
+
+#define TAP_DANCE_QUEUE_SIZE 32   // Potencia de 2; dos eventos por tecla como máximo
+
+class TapDanceEngine {
+private:
+  struct KeyState {
+    uint8_t state;
+    uint8_t dance;
+    uint8_t count;
+    unsigned long since;  // ms del último flanco
+  };
+
+  KeyState keys[16];
+  uint16_t pending;       // Teclas en PRESSED o RELEASED
+
+  TapDanceEvent queue[TAP_DANCE_QUEUE_SIZE];
+  uint8_t head;
+  uint8_t tail;
+
+  // Estadísticas
+  unsigned long taps;
+  unsigned long holds;
+
+  static bool hasHold(uint8_t dance) {
+    return TAP_DANCES[dance].hold.type != LAYER_ACTION_NONE;
+  }
+
+  // Cantidad de toques con acción definida
+  static uint8_t tapCount(uint8_t dance) {
+    uint8_t count = 0;
+    while(count < TAP_DANCE_MAX_TAPS && TAP_DANCES[dance].taps[count] != 0) {
+      count++;
+    }
+    return count;
+  }
+
+  void emit(uint8_t type, uint8_t button, uint8_t count) {
+    if((uint8_t)(head - tail) >= TAP_DANCE_QUEUE_SIZE) return;
+
+    TapDanceEvent& event = queue[head % TAP_DANCE_QUEUE_SIZE];
+    event.type = type;
+    event.button = button;
+    event.dance = keys[button].dance;
+    event.count = count;
+    head++;
+  }
+
+  void resolveTap(uint8_t button) {
+    emit(TAP_DANCE_TAP, button, keys[button].count);
+    keys[button].state = TAP_DANCE_IDLE;
+    pending &= ~(1 << button);
+    taps++;
+  }
+
+  void resolveHold(uint8_t button) {
+    // Los toques anteriores salen primero
+    if(keys[button].count > 1) {
+      emit(TAP_DANCE_TAP, button, keys[button].count - 1);
+      taps++;
+    }
+    emit(TAP_DANCE_HOLD, button, keys[button].count);
+    keys[button].state = TAP_DANCE_HELD;
+    pending &= ~(1 << button);
+    holds++;
+  }
+
+public:
+  TapDanceEngine() :
+    pending(0),
+    head(0),
+    tail(0),
+    taps(0),
+    holds(0) {
+    clear();
+  }
+
+  void press(uint8_t button, uint8_t dance, unsigned long now) {
+    if(button >= 16 || dance >= TAP_DANCE_COUNT) return;
+    KeyState& key = keys[button];
+
+    // Volvió con otro TD (cambió la capa): el toque pendiente sale antes
+    if(key.state == TAP_DANCE_RELEASED && key.dance != dance) {
+      resolveTap(button);
+    }
+
+    if(key.state == TAP_DANCE_RELEASED) {
+      key.count++;
+    } else {
+      key.dance = dance;
+      key.count = 1;
+    }
+
+    key.state = TAP_DANCE_PRESSED;
+    key.since = now;
+    pending |= 1 << button;
+  }
+
+  // Para todos los botones soltados; ignora los que no son TD
+  void release(uint8_t button, unsigned long now) {
+    if(button >= 16) return;
+    KeyState& key = keys[button];
+
+    if(key.state == TAP_DANCE_HELD) {
+      key.state = TAP_DANCE_IDLE;
+      return;
+    }
+
+    if(key.state != TAP_DANCE_PRESSED) return;
+
+    if(key.count >= tapCount(key.dance)) {
+      // Sin más toques posibles: el toque sale ya
+      resolveTap(button);
+    } else {
+      key.state = TAP_DANCE_RELEASED;
+      key.since = now;
+    }
+  }
+
+  // Otra tecla presionada: las teclas pendientes se deciden antes que ella
+  void otherKeyPressed(uint8_t button) {
+    uint16_t waiting = pending & ~(1 << button);
+    while(waiting) {
+      uint8_t i = __builtin_ctz(waiting);
+      waiting &= waiting - 1;
+
+      if(keys[i].state == TAP_DANCE_RELEASED) {
+        resolveTap(i);
+      } else if(TAP_HOLD_ON_OTHER_KEY && hasHold(keys[i].dance)) {
+        resolveHold(i);
+      }
+    }
+  }
+
+  // Vencimientos; llamar periódicamente
+  void update(unsigned long now) {
+    uint16_t waiting = pending;
+    while(waiting) {
+      uint8_t i = __builtin_ctz(waiting);
+      waiting &= waiting - 1;
+      KeyState& key = keys[i];
+
+      if(key.state == TAP_DANCE_PRESSED) {
+        // Sin acción de mantener, se decide al soltar
+        if(now - key.since >= TAP_HOLD_TERM_MS && hasHold(key.dance)) {
+          resolveHold(i);
+        }
+      } else if(now - key.since >= TAP_DANCE_TERM_MS) {
+        resolveTap(i);
+      }
+    }
+  }
+
+  bool nextEvent(TapDanceEvent* event) {
+    if(head == tail) return false;
+    *event = queue[tail % TAP_DANCE_QUEUE_SIZE];
+    tail++;
+    return true;
+  }
+
+  // Código del toque: el de esa cantidad o, si se pasó, el último definido
+  static uint8_t tapKeycode(uint8_t dance, uint8_t count) {
+    uint8_t defined = tapCount(dance);
+    if(defined == 0) return 0;
+    return TAP_DANCES[dance].taps[(count < defined ? count : defined) - 1];
+  }
+
+  bool isPending() {
+    return pending != 0;
+  }
+
+  void clear() {
+    for(uint8_t i = 0; i < 16; i++) {
+      keys[i].state = TAP_DANCE_IDLE;
+      keys[i].dance = 0;
+      keys[i].count = 0;
+      keys[i].since = 0;
+    }
+    pending = 0;
+    tail = head;
+  }
+
+  void getStats(unsigned long* tapTotal, unsigned long* holdTotal) {
+    *tapTotal = taps;
+    *holdTotal = holds;
+  }
+};
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef TRANSMIT_H
+#define TRANSMIT_H
+
+#include "config.h"
+#include "buffer.h"
+#include "report.h"
+#include "latency.h"
+
+// ============= TRANSMISOR HID NO BLOQUEANTE =============
+// Reemplaza press + delay + release: cada llamada a update() avanza la
+// máquina de estados según el tiempo transcurrido y retorna de inmediato,
+// así el escaneo de botones y encoders sigue corriendo mientras se envían
+// teclas. La tecla en vuelo se entrega como "tap" al HidReportEngine, que
+// la combina con los botones mantenidos.
+//
+//   IDLE --(hay tecla en buffer)--> HELD --(KEY_PRESS_DURATION)--> GAP
+//     ^                                                              |
+//     +----------------------(KEY_RELEASE_DELAY)---------------------+
+//
+// Al sacar un evento del buffer se abre su traza de latencia en el tracer
+// (si lo hay); el siguiente reporte HID enviado la cierra.
+class KeyTransmitter {
+private:
+  enum TxState {
+    TX_IDLE,    // Esperando tecla pendiente en el buffer
+    TX_HELD,    // Tecla presionada, esperando para liberarla
+    TX_GAP      // Tecla liberada, pausa antes de la siguiente
+  };
+
+  PriorityKeyBuffer* source;
+  HidReportEngine* output;
+  LatencyTracer* tracer;
+  TxState state;
+  uint8_t currentKey;
+  uint8_t repeatsLeft;      // Repeticiones fusionadas pendientes de currentKey
+  unsigned long stateStartTime;
+
+  // Estadísticas
+  unsigned long keysSent;
+  uint8_t maxDepth;
+  unsigned long rateWindowStart;
+  unsigned long rateWindowKeys;
+  unsigned long lastRate;   // teclas/s de la última ventana
+
+public:
+  KeyTransmitter(PriorityKeyBuffer* buffer, HidReportEngine* engine, LatencyTracer* latency = 0) :
+    source(buffer),
+    output(engine),
+    tracer(latency),
+    state(TX_IDLE),
+    currentKey(0),
+    repeatsLeft(0),
+    stateStartTime(0),
+    keysSent(0),
+    maxDepth(0),
+    rateWindowStart(0),
+    rateWindowKeys(0),
+    lastRate(0) {}
+
+  // Avanzar la máquina de estados; nunca bloquea
+  void update() {
+    unsigned long now = millis();
+
+    uint8_t depth = source->getCount();
+    if(depth > maxDepth) {
+      maxDepth = depth;
+    }
+
+    if(state == TX_HELD) {
+      if(now - stateStartTime < KEY_PRESS_DURATION) return;
+
+      output->setTapKey(0);
+      state = TX_GAP;
+      stateStartTime = now;
+    }
+
+    if(state == TX_GAP) {
+      if(now - stateStartTime < KEY_RELEASE_DELAY) return;
+      state = TX_IDLE;
+    }
+
+    KeyEvent event;
+    if(state != TX_IDLE) return;
+
+    if(repeatsLeft > 0) {
+      repeatsLeft--;
+    } else if(source->pop(&event)) {
+      currentKey = event.keycode;
+      repeatsLeft = event.repeat - 1;
+      if(tracer) {
+        tracer->begin(SOURCE_QUEUE, event.trace);
+      }
+    } else {
+      return;
+    }
+
+    output->setTapKey(currentKey);
+    state = TX_HELD;
+    stateStartTime = now;
+
+    keysSent++;
+    rateWindowKeys++;
+  }
+
+  // Hay una tecla en vuelo (presionada o en la pausa posterior)
+  bool isBusy() {
+    return state != TX_IDLE;
+  }
+
+  // Teclas que faltan enviar: las del buffer y las repeticiones pendientes
+  // de la actual. A ritmo HID cada una tarda KEY_PRESS_DURATION + KEY_RELEASE_DELAY
+  uint16_t getPendingKeys() {
+    return source->getKeyCount() + repeatsLeft;
+  }
+
+  // Profundidad del pipeline: teclas en buffer más la que está en vuelo
+  uint8_t getDepth() {
+    uint16_t depth = getPendingKeys() + (state == TX_HELD ? 1 : 0);
+    return depth > 255 ? 255 : depth;
+  }
+
+  // Teclas por segundo desde la última consulta
+  unsigned long sampleRate() {
+    unsigned long now = millis();
+    unsigned long elapsed = now - rateWindowStart;
+
+    if(elapsed > 0) {
+      lastRate = (rateWindowKeys * 1000UL) / elapsed;
+    }
+
+    rateWindowStart = now;
+    rateWindowKeys = 0;
+    return lastRate;
+  }
+
+  void getStats(unsigned long* sent, uint8_t* depth, uint8_t* peakDepth) {
+    *sent = keysSent;
+    *depth = getDepth();
+    *peakDepth = maxDepth;
+  }
+
+  void resetStats() {
+    keysSent = 0;
+    maxDepth = 0;
+    rateWindowKeys = 0;
+    rateWindowStart = millis();
+  }
+};
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// Sustituto mínimo del core Arduino/STM32 para compilar el sketch en host.
+// millis()/micros()/delay() trabajan sobre el reloj virtual de sim.h.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "sim.h"
+#include "stm32f1xx.h"
+#include "stm32_hal_flash.h"
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE  2
+#define FALLING 3
+#define RISING  4
+
+#define DEC 10
+#define HEX 16
+#define BIN 2
+
+// Pines del Blue Pill usados por el sketch
+#define PA0  0
+#define PA1  1
+#define PA2  2
+#define PA3  3
+#define PB6  22
+#define PB7  23
+#define PB8  24
+#define PC13 45
+
+// ============= TIEMPO =============
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// ============= GPIO =============
+void pinMode(uint32_t pin, uint32_t mode);
+int digitalRead(uint32_t pin);
+void digitalWrite(uint32_t pin, uint32_t value);
+
+// ============= INTERRUPCIONES =============
+// Las ISR se ejecutan en el instante virtual en que cambia el pin
+#define digitalPinToInterrupt(p) (p)
+
+void attachInterrupt(uint32_t pin, void (*callback)(void), uint32_t mode);
+void detachInterrupt(uint32_t pin);
+void interrupts();
+void noInterrupts();
+
+// ============= SISTEMA =============
+void NVIC_SystemReset();
+
+// ============= PRINT =============
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+
+  size_t write(const char* str);
+  size_t write(const uint8_t* buffer, size_t size);
+
+  size_t print(const char* str);
+  size_t print(char c);
+  size_t print(unsigned char value, int base = DEC);
+  size_t print(int value, int base = DEC);
+  size_t print(unsigned int value, int base = DEC);
+  size_t print(long value, int base = DEC);
+  size_t print(unsigned long value, int base = DEC);
+  size_t print(double value, int digits = 2);
+
+  size_t println();
+  size_t println(const char* str);
+  size_t println(char c);
+  size_t println(unsigned char value, int base = DEC);
+  size_t println(int value, int base = DEC);
+  size_t println(unsigned int value, int base = DEC);
+  size_t println(long value, int base = DEC);
+  size_t println(unsigned long value, int base = DEC);
+  size_t println(double value, int digits = 2);
+
+private:
+  size_t printNumber(unsigned long value, int base);
+};
+
+// ============= SERIAL =============
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long baud);
+  int available();
+  int read();
+  size_t write(uint8_t c) override;
+  using Print::write;
+  operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+// Salida de Serial visible en stderr (opción -v del simulador)
+extern bool simSerialEcho;
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef EEPROM_H
+#define EEPROM_H
+
+// EEPROM emulada en flash, como la del core STM32: put() solo escribe los
+// bytes que cambian, pero cada byte escrito cuesta un borrado de página.
+
+#include "Arduino.h"
+
+class EEPROMClass {
+public:
+  uint8_t read(int address) {
+    return simEepromRead(address);
+  }
+
+  void write(int address, uint8_t value) {
+    simEepromWrite(address, value);
+  }
+
+  void update(int address, uint8_t value) {
+    if(read(address) != value) {
+      write(address, value);
+    }
+  }
+
+  uint16_t length() {
+    return SIM_EEPROM_SIZE;
+  }
+
+  template<typename T> T& get(int address, T& value) {
+    uint8_t* ptr = (uint8_t*)&value;
+    for(size_t i = 0; i < sizeof(T); i++) {
+      ptr[i] = read(address + i);
+    }
+    return value;
+  }
+
+  template<typename T> const T& put(int address, const T& value) {
+    const uint8_t* ptr = (const uint8_t*)&value;
+    for(size_t i = 0; i < sizeof(T); i++) {
+      update(address + i, ptr[i]);
+    }
+    return value;
+  }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
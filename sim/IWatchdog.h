@@ -0,0 +1,26 @@
+#ifndef IWATCHDOG_H
+#define IWATCHDOG_H
+
+// Watchdog simulado: no reinicia, pero sim.cpp registra cada vez que el
+// reloj virtual supera el timeout sin una recarga.
+
+#include "Arduino.h"
+
+class IWatchdogClass {
+public:
+  void begin(uint32_t timeout, uint32_t window = 0) {
+    (void)window;
+    simWatchdogBegin(timeout);
+  }
+
+  void reload() {
+    simWatchdogReload();
+  }
+
+  bool isSupported() { return true; }
+  bool isReset(bool clear = false) { (void)clear; return simWatchdogBoot; }
+};
+
+extern IWatchdogClass IWatchdog;
+
+#endif
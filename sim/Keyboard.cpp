@@ -0,0 +1,164 @@
+#include "Keyboard.h"
+#include "usbd_hid_composite_if.h"
+
+Keyboard_ Keyboard;
+
+// ============= MAPA ASCII -> USAGE HID (US) =============
+#define SHIFT 0x80
+
+static const uint8_t asciimap[128] = {
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,   // NUL..BEL
+  0x2a, 0x2b, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00,   // BS TAB LF ..
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x29, 0x00, 0x00, 0x00, 0x00,   // .. ESC ..
+  0x2c,           // ' '
+  0x1e | SHIFT,   // !
+  0x34 | SHIFT,   // "
+  0x20 | SHIFT,   // #
+  0x21 | SHIFT,   // $
+  0x22 | SHIFT,   // %
+  0x24 | SHIFT,   // &
+  0x34,           // '
+  0x26 | SHIFT,   // (
+  0x27 | SHIFT,   // )
+  0x25 | SHIFT,   // *
+  0x2e | SHIFT,   // +
+  0x36,           // ,
+  0x2d,           // -
+  0x37,           // .
+  0x38,           // /
+  0x27, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26,  // 0-9
+  0x33 | SHIFT,   // :
+  0x33,           // ;
+  0x36 | SHIFT,   // <
+  0x2e,           // =
+  0x37 | SHIFT,   // >
+  0x38 | SHIFT,   // ?
+  0x1f | SHIFT,   // @
+  0x04 | SHIFT, 0x05 | SHIFT, 0x06 | SHIFT, 0x07 | SHIFT, 0x08 | SHIFT,  // A-E
+  0x09 | SHIFT, 0x0a | SHIFT, 0x0b | SHIFT, 0x0c | SHIFT, 0x0d | SHIFT,  // F-J
+  0x0e | SHIFT, 0x0f | SHIFT, 0x10 | SHIFT, 0x11 | SHIFT, 0x12 | SHIFT,  // K-O
+  0x13 | SHIFT, 0x14 | SHIFT, 0x15 | SHIFT, 0x16 | SHIFT, 0x17 | SHIFT,  // P-T
+  0x18 | SHIFT, 0x19 | SHIFT, 0x1a | SHIFT, 0x1b | SHIFT, 0x1c | SHIFT,  // U-Y
+  0x1d | SHIFT,   // Z
+  0x2f,           // [
+  0x31,           // '\'
+  0x30,           // ]
+  0x23 | SHIFT,   // ^
+  0x2d | SHIFT,   // _
+  0x35,           // `
+  0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d,  // a-j
+  0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,  // k-t
+  0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,                          // u-z
+  0x2f | SHIFT,   // {
+  0x31 | SHIFT,   // |
+  0x30 | SHIFT,   // }
+  0x35 | SHIFT,   // ~
+  0x00            // DEL
+};
+
+uint8_t simUsageForKeycode(uint8_t keycode) {
+  if(keycode >= 136) return keycode - 136;
+  if(keycode >= 128) return 0;
+  return asciimap[keycode] & ~SHIFT;
+}
+
+// ============= KEYBOARD_ =============
+Keyboard_::Keyboard_() {
+  memset(&_keyReport, 0, sizeof(_keyReport));
+}
+
+void Keyboard_::begin() {}
+void Keyboard_::end() {}
+
+void Keyboard_::sendReport(KeyReport* keys) {
+  uint8_t buf[8] = {
+    keys->modifiers, keys->reserved,
+    keys->keys[0], keys->keys[1], keys->keys[2],
+    keys->keys[3], keys->keys[4], keys->keys[5]
+  };
+  HID_Composite_keyboard_sendReport(buf, 8);
+}
+
+size_t Keyboard_::press(uint8_t k) {
+  uint8_t i;
+  if(k >= 136) {
+    k = k - 136;
+  } else if(k >= 128) {
+    _keyReport.modifiers |= (1 << (k - 128));
+    k = 0;
+  } else {
+    k = asciimap[k];
+    if(!k) return 0;
+    if(k & SHIFT) {
+      _keyReport.modifiers |= 0x02;
+      k &= ~SHIFT;
+    }
+  }
+
+  if(_keyReport.keys[0] != k && _keyReport.keys[1] != k &&
+     _keyReport.keys[2] != k && _keyReport.keys[3] != k &&
+     _keyReport.keys[4] != k && _keyReport.keys[5] != k) {
+    for(i = 0; i < 6; i++) {
+      if(_keyReport.keys[i] == 0x00) {
+        _keyReport.keys[i] = k;
+        break;
+      }
+    }
+    if(i == 6) return 0;
+  }
+
+  sendReport(&_keyReport);
+  return 1;
+}
+
+size_t Keyboard_::release(uint8_t k) {
+  if(k >= 136) {
+    k = k - 136;
+  } else if(k >= 128) {
+    _keyReport.modifiers &= ~(1 << (k - 128));
+    k = 0;
+  } else {
+    k = asciimap[k];
+    if(!k) return 0;
+    if(k & SHIFT) {
+      _keyReport.modifiers &= ~(0x02);
+      k &= ~SHIFT;
+    }
+  }
+
+  for(uint8_t i = 0; i < 6; i++) {
+    if(k != 0 && _keyReport.keys[i] == k) {
+      _keyReport.keys[i] = 0x00;
+    }
+  }
+
+  sendReport(&_keyReport);
+  return 1;
+}
+
+void Keyboard_::releaseAll() {
+  memset(&_keyReport, 0, sizeof(_keyReport));
+  sendReport(&_keyReport);
+}
+
+size_t Keyboard_::write(uint8_t c) {
+  uint8_t p = press(c);
+  release(c);
+  return p;
+}
+
+// ============= TRANSPORTE HID =============
+bool simNkroHost = false;
+
+void HID_Composite_keyboard_sendReport(uint8_t* report, uint16_t len) {
+  simHidSubmit(report, len);
+}
+
+// Interfaz NKRO de un core USB modificado; sustituye la versión débil del
+// firmware. Rechaza el reporte si el host no la habilitó (protocolo de arranque).
+bool HID_NKRO_sendReport(uint8_t* report, uint16_t len) {
+  if(!simNkroHost) return false;
+  simHidSubmit(report, len);
+  return true;
+}
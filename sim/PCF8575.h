@@ -0,0 +1,46 @@
+#ifndef PCF8575_H
+#define PCF8575_H
+
+// Sustituto de la librería PCF8575 de Renzo Mischianti (modo PCF8575_LOW_MEMORY,
+// digitalReadAll() devuelve los 16 pines en un uint16_t).
+
+#include "Arduino.h"
+#include "Wire.h"
+
+class PCF8575 {
+private:
+  uint8_t address;
+  uint16_t lastRead;
+
+public:
+  PCF8575(uint8_t addr) : address(addr), lastRead(0xFFFF) {}
+
+  bool begin() {
+    Wire.begin();
+    Wire.beginTransmission(address);
+    return Wire.endTransmission() == 0;
+  }
+
+  void pinMode(uint8_t pin, uint8_t mode, uint8_t outputStart = HIGH) {
+    (void)pin;
+    (void)mode;
+    (void)outputStart;
+  }
+
+  uint16_t digitalReadAll() {
+    if(Wire.requestFrom(address, (uint8_t)2) < 2) {
+      return 0xFFFF;
+    }
+
+    uint16_t low = Wire.read();
+    uint16_t high = Wire.read();
+    lastRead = low | (high << 8);
+    return lastRead;
+  }
+
+  uint8_t digitalRead(uint8_t pin) {
+    return (digitalReadAll() >> pin) & 1;
+  }
+};
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+// Bus I2C simulado: solo existe el PCF8575 en PCF8575_ADDRESS (0x20).
+// Cada transacción bloquea el reloj virtual el tiempo que tardaría a 400kHz.
+
+#include "Arduino.h"
+#include "stm32_hal_i2c.h"
+
+#define SIM_PCF8575_ADDRESS 0x20
+
+class TwoWire {
+private:
+  uint8_t txAddress;
+  uint8_t txBytes;
+  uint8_t rxBuffer[2];
+  uint8_t rxLength;
+  uint8_t rxIndex;
+  I2C_HandleTypeDef handle;
+
+public:
+  TwoWire() : txAddress(0), txBytes(0), rxLength(0), rxIndex(0), handle() {}
+
+  // begin()/end() reinician el periférico igual que i2c_init()/i2c_deinit()
+  void begin() {
+    handle.State = HAL_I2C_STATE_READY;
+    handle.ErrorCode = HAL_I2C_ERROR_NONE;
+  }
+
+  void end() {
+    handle.State = HAL_I2C_STATE_RESET;
+  }
+
+  I2C_HandleTypeDef* getHandle() { return &handle; }
+  void setClock(uint32_t frequency) { (void)frequency; }
+
+  void beginTransmission(uint8_t address) {
+    txAddress = address;
+    txBytes = 0;
+  }
+
+  size_t write(uint8_t data) {
+    (void)data;
+    txBytes++;
+    return 1;
+  }
+
+  // 0 = éxito, 2 = NACK en dirección (igual que el core)
+  uint8_t endTransmission(bool sendStop = true) {
+    (void)sendStop;
+    simI2CTransaction(txBytes);
+    if(txAddress != SIM_PCF8575_ADDRESS || !simPcfPresent()) {
+      return 2;
+    }
+    return 0;
+  }
+
+  uint8_t requestFrom(uint8_t address, uint8_t quantity) {
+    simI2CTransaction(quantity);
+    rxIndex = 0;
+    rxLength = 0;
+
+    if(address != SIM_PCF8575_ADDRESS || !simPcfPresent()) {
+      return 0;
+    }
+
+    // Botones a GND: un botón presionado se lee como 0
+    uint16_t pins = ~simGetButtons();
+    rxBuffer[0] = pins & 0xFF;
+    rxBuffer[1] = pins >> 8;
+    rxLength = quantity > 2 ? 2 : quantity;
+    simRecordButtonScan();
+
+    return rxLength;
+  }
+
+  int available() {
+    return rxLength - rxIndex;
+  }
+
+  int read() {
+    if(rxIndex >= rxLength) return -1;
+    return rxBuffer[rxIndex++];
+  }
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,184 @@
+// Banco de pruebas en host de las políticas de debounce (debounce.h).
+// Genera una señal sintética para 16 botones —pulsaciones con rebotes y
+// glitches aislados de EMI— con una semilla fija, la filtra con cada
+// política y compara la latencia de presión/liberación, los flancos
+// falsos y perdidos, y el costo por actualización de las 16 entradas.
+//
+//   make bench
+
+#include <Arduino.h>
+#include "debounce.h"
+
+#include <chrono>
+#include <vector>
+
+// ============= PARÁMETROS DE LA SEÑAL =============
+static const uint32_t TICKS = 200000;          // Muestras (una cada MAIN_LOOP_INTERVAL)
+static const uint8_t LANES = 16;
+static const uint32_t MIN_STABLE_TICKS = 12;   // Entre cambios intencionados
+static const uint32_t MAX_STABLE_TICKS = 80;
+static const uint8_t MAX_BOUNCES = 4;          // Conmutaciones extra tras cada cambio
+static const uint32_t GLITCH_ODDS = 400;       // 1 de N ticks estables trae un glitch
+
+struct Signal {
+  std::vector<uint16_t> raw;       // Lo que lee el PCF8575
+  std::vector<uint16_t> intended;  // Lo que el usuario hizo
+};
+
+static uint32_t rngState = 0x12345678;
+
+static uint32_t nextRandom() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState;
+}
+
+static Signal buildSignal() {
+  Signal sig;
+  sig.raw.assign(TICKS, 0);
+  sig.intended.assign(TICKS, 0);
+
+  for(uint8_t lane = 0; lane < LANES; lane++) {
+    uint16_t bit = 1 << lane;
+    bool level = false;
+    uint32_t t = nextRandom() % MAX_STABLE_TICKS;
+
+    while(t < TICKS) {
+      uint32_t stable = MIN_STABLE_TICKS + nextRandom() % (MAX_STABLE_TICKS - MIN_STABLE_TICKS);
+      uint32_t end = t + stable < TICKS ? t + stable : TICKS;
+
+      for(uint32_t i = t; i < end; i++) {
+        if(level) {
+          sig.intended[i] |= bit;
+          sig.raw[i] |= bit;
+        }
+      }
+
+      // Rebotes: alternar un tick cada uno justo después del cambio
+      uint8_t bounces = nextRandom() % (MAX_BOUNCES + 1);
+      for(uint8_t b = 0; b < bounces && t + 1 + 2 * b < end; b++) {
+        sig.raw[t + 1 + 2 * b] ^= bit;
+      }
+
+      // Glitches aislados de un tick en la parte estable
+      for(uint32_t i = t + 2 * MAX_BOUNCES + 2; i < end; i++) {
+        if(nextRandom() % GLITCH_ODDS == 0) sig.raw[i] ^= bit;
+      }
+
+      level = !level;
+      t = end;
+    }
+  }
+
+  return sig;
+}
+
+// ============= EVALUACIÓN =============
+struct Result {
+  unsigned long presses, releases;
+  unsigned long missed, spurious;
+  unsigned long pressLatencyTotal, pressLatencyMax;
+  unsigned long releaseLatencyTotal, releaseLatencyMax;
+  double nsPerUpdate;
+  size_t bytes;
+};
+
+template<typename Policy>
+static Result evaluate(const Signal& sig) {
+  Result r = {};
+  VerticalDebounce<uint16_t, Policy> filter;
+  r.bytes = sizeof(filter);
+
+  // Cambio intencionado pendiente de aceptar, por botón
+  long pendingSince[LANES];
+  bool pendingPress[LANES];
+  for(uint8_t i = 0; i < LANES; i++) pendingSince[i] = -1;
+
+  for(uint32_t t = 0; t < TICKS; t++) {
+    uint16_t now = sig.intended[t];
+    uint16_t before = t ? sig.intended[t - 1] : 0;
+
+    for(uint8_t lane = 0; lane < LANES; lane++) {
+      uint16_t bit = 1 << lane;
+      if((now ^ before) & bit) {
+        if(pendingSince[lane] >= 0) r.missed++;
+        pendingSince[lane] = t;
+        pendingPress[lane] = now & bit;
+        if(now & bit) r.presses++; else r.releases++;
+      }
+    }
+
+    filter.update(sig.raw[t], 1);
+    uint16_t accepted = filter.getPressed() | filter.getReleased();
+
+    while(accepted) {
+      uint8_t lane = __builtin_ctz(accepted);
+      accepted &= accepted - 1;
+      bool isPress = (filter.getPressed() >> lane) & 1;
+
+      if(pendingSince[lane] >= 0 && pendingPress[lane] == isPress) {
+        unsigned long latency = (t - pendingSince[lane]) * MAIN_LOOP_INTERVAL;
+        if(isPress) {
+          r.pressLatencyTotal += latency;
+          if(latency > r.pressLatencyMax) r.pressLatencyMax = latency;
+        } else {
+          r.releaseLatencyTotal += latency;
+          if(latency > r.releaseLatencyMax) r.releaseLatencyMax = latency;
+        }
+        pendingSince[lane] = -1;
+      } else {
+        r.spurious++;
+      }
+    }
+  }
+
+  // Costo: la misma señal varias veces, con el resultado consumido
+  const int rounds = 20;
+  volatile uint16_t sink = 0;
+  VerticalDebounce<uint16_t, Policy> timed;
+  auto start = std::chrono::steady_clock::now();
+  for(int round = 0; round < rounds; round++) {
+    for(uint32_t t = 0; t < TICKS; t++) {
+      timed.update(sig.raw[t], 1);
+      sink = sink + timed.getPressed();
+    }
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  r.nsPerUpdate = std::chrono::duration<double, std::nano>(elapsed).count() / (rounds * (double)TICKS);
+
+  return r;
+}
+
+template<typename Policy>
+static void report(const char* params, const Signal& sig) {
+  Result r = evaluate<Policy>(sig);
+
+  printf("%-11s %-9s %6.1f %5lu  %6.1f %5lu  %7lu %8lu  %6.2f  %3zu\n",
+         Policy::name(), params,
+         r.presses ? (double)r.pressLatencyTotal / r.presses : 0.0, r.pressLatencyMax,
+         r.releases ? (double)r.releaseLatencyTotal / r.releases : 0.0, r.releaseLatencyMax,
+         r.missed, r.spurious, r.nsPerUpdate, r.bytes);
+}
+
+int main() {
+  Signal sig = buildSignal();
+
+  printf("Debounce de 16 botones: %lu muestras cada %d ms, hasta %d rebotes por cambio, "
+         "glitch 1/%lu ticks\n\n", (unsigned long)TICKS, MAIN_LOOP_INTERVAL, MAX_BOUNCES,
+         (unsigned long)GLITCH_ODDS);
+  printf("%-11s %-9s %6s %5s  %6s %5s  %7s %8s  %6s  %3s\n",
+         "politica", "params", "pres ms", "max", "sol ms", "max",
+         "perdido", "falsos", "ns/upd", "B");
+
+  report<EagerDebounce<BUTTON_DEBOUNCE_TICKS> >("10", sig);
+  report<EagerDebounce<4> >("4", sig);
+  report<WindowDebounce<5> >("5", sig);
+  report<WindowDebounce<3> >("3", sig);
+  report<IntegratingDebounce<5> >("5", sig);
+  report<IntegratingDebounce<3> >("3", sig);
+  report<AsymmetricDebounce<1, 5> >("1/5", sig);
+  report<AsymmetricDebounce<2, 5> >("2/5", sig);
+
+  return 0;
+}
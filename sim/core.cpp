@@ -0,0 +1,156 @@
+#include "Arduino.h"
+#include "Wire.h"
+#include "EEPROM.h"
+#include "IWatchdog.h"
+
+#include <deque>
+
+HardwareSerial Serial;
+TwoWire Wire;
+EEPROMClass EEPROM;
+IWatchdogClass IWatchdog;
+bool simSerialEcho = false;
+
+static std::deque<uint8_t> serialRx;
+
+// ============= TIEMPO =============
+unsigned long millis() {
+  return (unsigned long)(simMicros() / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)simMicros();
+}
+
+void delay(unsigned long ms) {
+  simAdvance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  simAdvance(us);
+}
+
+// ============= GPIO =============
+void pinMode(uint32_t pin, uint32_t mode) {
+  if(mode == INPUT_PULLUP) {
+    simSetPin(pin, true);
+  }
+}
+
+int digitalRead(uint32_t pin) {
+  return simGetPin(pin) ? HIGH : LOW;
+}
+
+void digitalWrite(uint32_t pin, uint32_t value) {
+  simSetPin(pin, value != LOW);
+}
+
+// ============= INTERRUPCIONES =============
+void attachInterrupt(uint32_t pin, void (*callback)(void), uint32_t mode) {
+  simAttachInterrupt(pin, callback, mode);
+}
+
+void detachInterrupt(uint32_t pin) {
+  simAttachInterrupt(pin, nullptr, 0);
+}
+
+void interrupts() {}
+void noInterrupts() {}
+
+// ============= SISTEMA =============
+void NVIC_SystemReset() {
+  printf("%10.3f ms  RESET  NVIC_SystemReset()\n", simMicros() / 1000.0);
+  simPrintSummary(simMicros());
+  exit(3);
+}
+
+// ============= PRINT =============
+size_t Print::write(const char* str) {
+  return write((const uint8_t*)str, strlen(str));
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while(size--) {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::printNumber(unsigned long value, int base) {
+  char buf[8 * sizeof(long) + 1];
+  char* str = &buf[sizeof(buf) - 1];
+  *str = '\0';
+
+  if(base < 2) base = 10;
+
+  do {
+    char digit = value % base;
+    value /= base;
+    *--str = digit < 10 ? digit + '0' : digit + 'A' - 10;
+  } while(value);
+
+  return write(str);
+}
+
+size_t Print::print(const char* str) { return write(str); }
+size_t Print::print(char c) { return write((uint8_t)c); }
+size_t Print::print(unsigned char value, int base) { return print((unsigned long)value, base); }
+size_t Print::print(int value, int base) { return print((long)value, base); }
+size_t Print::print(unsigned int value, int base) { return print((unsigned long)value, base); }
+
+size_t Print::print(long value, int base) {
+  if(base == 10 && value < 0) {
+    return write((uint8_t)'-') + printNumber(-value, 10);
+  }
+  return printNumber((unsigned long)value, base);
+}
+
+size_t Print::print(unsigned long value, int base) {
+  return printNumber(value, base);
+}
+
+size_t Print::print(double value, int digits) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.*f", digits, value);
+  return write(buf);
+}
+
+size_t Print::println() { return write("\r\n"); }
+size_t Print::println(const char* str) { return print(str) + println(); }
+size_t Print::println(char c) { return print(c) + println(); }
+size_t Print::println(unsigned char value, int base) { return print(value, base) + println(); }
+size_t Print::println(int value, int base) { return print(value, base) + println(); }
+size_t Print::println(unsigned int value, int base) { return print(value, base) + println(); }
+size_t Print::println(long value, int base) { return print(value, base) + println(); }
+size_t Print::println(unsigned long value, int base) { return print(value, base) + println(); }
+size_t Print::println(double value, int digits) { return print(value, digits) + println(); }
+
+// ============= SERIAL =============
+void HardwareSerial::begin(unsigned long baud) {
+  (void)baud;
+}
+
+int HardwareSerial::available() {
+  return serialRx.size();
+}
+
+int HardwareSerial::read() {
+  if(serialRx.empty()) return -1;
+  uint8_t c = serialRx.front();
+  serialRx.pop_front();
+  return c;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  if(simSerialEcho && c != '\r') {
+    fputc(c, stderr);
+  }
+  return 1;
+}
+
+void simSerialFeed(const char* text) {
+  while(*text) {
+    serialRx.push_back((uint8_t)*text++);
+  }
+}
@@ -0,0 +1,272 @@
+// Simulador en host del firmware AudioSimKeyboard.
+//
+// Ejecuta setup() y luego loop() sobre un reloj virtual, aplicando los
+// eventos de un trace de entrada, e imprime cada reporte HID con su
+// timestamp seguido de un resumen de latencia y bloqueos.
+//
+// Uso: keyboard_sim [-q costo_loop_us] [-v] [-n] [-w] [-f imagen_kb] archivo.trace
+//   -v  copia la salida Serial del firmware a stderr
+//   -n  el host acepta la interfaz NKRO (compilar con HID_NKRO_ENABLED=true)
+//   -w  arranca como tras un reset por watchdog
+//   -f  tamaño de la imagen del firmware en flash (KB; por defecto 40)
+//   -R  (interna) sesión a correr tras un reboot y archivo con la flash
+//
+// Formato del trace (tiempos en ms desde el fin de setup(), admite decimales;
+// botones 0-15 en el orden de BUTTON_MAP, encoders 0=A 1=B):
+//   <t> press <boton> [rebotes]
+//   <t> release <boton> [rebotes]
+//   <t> tap <boton> <duracion_ms>
+//   <t> turn <encoder> <transiciones> <intervalo_ms>   (negativo = antihorario)
+//   <t> i2c up|down|stuck
+//   <t> serial <texto>
+//   <t> reboot      corte de energía: imprime el resumen y relanza el
+//                   simulador con la misma flash y EEPROM; los tiempos que
+//                   siguen cuentan desde el fin del nuevo setup()
+//   <t> end
+
+#include "sim.h"
+#include "Arduino.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+// ============= CONFIGURACIÓN =============
+#define SIM_DEFAULT_LOOP_COST_US 20
+#define SIM_BOUNCE_US 300
+#define SIM_TAIL_US 1000000ULL
+
+static const uint8_t ENCODER_PINS[2][2] = {
+  {PA0, PA1},
+  {PA2, PA3}
+};
+
+// Secuencia de cuadratura (A<<1 | B) en sentido horario, partiendo del reposo
+static const uint8_t QUADRATURE_CW[4] = {0x3, 0x1, 0x0, 0x2};
+static uint8_t encoderPhase[2] = {0, 0};
+
+static uint64_t usFromMs(double ms) {
+  return (uint64_t)(ms * 1000.0 + 0.5);
+}
+
+// ============= EXPANSIÓN DE EVENTOS =============
+static void scheduleButton(uint64_t t, int button, bool pressed, int bounces) {
+  if(pressed) {
+    simSchedule(t, SIM_EVT_PRESS_MARK, button, 0);
+  }
+
+  simSchedule(t, SIM_EVT_BUTTON, button, pressed);
+  for(int i = 0; i < bounces; i++) {
+    uint64_t bounceTime = t + (uint64_t)(2 * i + 1) * SIM_BOUNCE_US;
+    simSchedule(bounceTime, SIM_EVT_BUTTON, button, !pressed);
+    simSchedule(bounceTime + SIM_BOUNCE_US, SIM_EVT_BUTTON, button, pressed);
+  }
+}
+
+static void scheduleTurn(uint64_t t, int encoder, int transitions, double intervalMs) {
+  int step = transitions > 0 ? 1 : 3;
+  int count = abs(transitions);
+  uint64_t interval = usFromMs(intervalMs);
+
+  for(int i = 0; i < count; i++) {
+    encoderPhase[encoder] = (encoderPhase[encoder] + step) % 4;
+    uint8_t state = QUADRATURE_CW[encoderPhase[encoder]];
+    uint64_t when = t + (uint64_t)i * interval;
+
+    simSchedule(when, SIM_EVT_PIN, ENCODER_PINS[encoder][0], (state >> 1) & 1);
+    simSchedule(when, SIM_EVT_PIN, ENCODER_PINS[encoder][1], state & 1);
+  }
+}
+
+// ============= LECTURA DEL TRACE =============
+// Solo se cargan los eventos de la sesión pedida (los "reboot" separan
+// sesiones); *rebootAt queda en true si la sesión termina en un reboot
+static bool loadTrace(const char* path, int session, uint64_t origin, uint64_t* endTime,
+                      bool* rebootAt) {
+  FILE* file = fopen(path, "r");
+  if(!file) {
+    fprintf(stderr, "No se pudo abrir %s\n", path);
+    return false;
+  }
+
+  char line[256];
+  int lineNumber = 0;
+  uint64_t lastEvent = origin;
+  bool explicitEnd = false;
+  int current = 0;
+  *rebootAt = false;
+
+  while(fgets(line, sizeof(line), file)) {
+    lineNumber++;
+
+    char* hash = strchr(line, '#');
+    if(hash) *hash = '\0';
+
+    double timeMs;
+    char command[16];
+    int consumed = 0;
+    if(sscanf(line, "%lf %15s %n", &timeMs, command, &consumed) < 2) {
+      continue;
+    }
+
+    const char* args = line + consumed;
+    uint64_t t = origin + usFromMs(timeMs);
+
+    if(!strcmp(command, "reboot")) {
+      if(current++ < session) continue;
+      *endTime = t;
+      *rebootAt = true;
+      explicitEnd = true;
+      break;
+    }
+    if(current != session) continue;
+
+    int a = 0, b = 0;
+    double interval = 0;
+
+    if(!strcmp(command, "press") && sscanf(args, "%d %d", &a, &b) >= 1) {
+      scheduleButton(t, a, true, b);
+    } else if(!strcmp(command, "release") && sscanf(args, "%d %d", &a, &b) >= 1) {
+      scheduleButton(t, a, false, b);
+    } else if(!strcmp(command, "tap") && sscanf(args, "%d %lf", &a, &interval) == 2) {
+      scheduleButton(t, a, true, 0);
+      scheduleButton(t + usFromMs(interval), a, false, 0);
+      t += usFromMs(interval);
+    } else if(!strcmp(command, "turn") && sscanf(args, "%d %d %lf", &a, &b, &interval) == 3) {
+      scheduleTurn(t, a, b, interval);
+      t += (uint64_t)abs(b) * usFromMs(interval);
+    } else if(!strcmp(command, "i2c")) {
+      int state = !strncmp(args, "down", 4) ? 0 : (!strncmp(args, "stuck", 5) ? 2 : 1);
+      simSchedule(t, SIM_EVT_I2C, state, 0);
+    } else if(!strcmp(command, "serial")) {
+      char text[128];
+      strncpy(text, args, sizeof(text) - 1);
+      text[sizeof(text) - 1] = '\0';
+      text[strcspn(text, "\r\n")] = '\0';
+      simSchedule(t, SIM_EVT_SERIAL, 0, 0, text);
+    } else if(!strcmp(command, "end")) {
+      *endTime = t;
+      explicitEnd = true;
+    } else {
+      fprintf(stderr, "%s:%d: comando invalido: %s", path, lineNumber, line);
+      fclose(file);
+      return false;
+    }
+
+    if(t > lastEvent) lastEvent = t;
+  }
+
+  fclose(file);
+
+  if(!explicitEnd) {
+    *endTime = lastEvent + SIM_TAIL_US;
+  }
+  return true;
+}
+
+// ============= PROGRAMA PRINCIPAL =============
+static void usage() {
+  fprintf(stderr, "Uso: keyboard_sim [-q costo_loop_us] [-v] [-n] [-w] [-f imagen_kb] archivo.trace\n");
+  exit(1);
+}
+
+// Relanzar el simulador en la sesión siguiente con la flash y la EEPROM
+// actuales, como un arranque en frío: el firmware vuelve a construir todo
+// su estado en RAM. -w no se repite porque no es un reset por watchdog.
+static void reboot(char** argv, int session) {
+  char statePath[] = "/tmp/keyboard_sim_XXXXXX";
+  int fd = mkstemp(statePath);
+  if(fd < 0 || !simSaveNonVolatile(statePath)) {
+    fprintf(stderr, "No se pudo guardar la flash para el reboot\n");
+    exit(1);
+  }
+  close(fd);
+
+  char sessionArg[16];
+  snprintf(sessionArg, sizeof(sessionArg), "%d", session);
+
+  std::vector<char*> args;
+  for(int i = 0; argv[i]; i++) {
+    if(!strcmp(argv[i], "-R")) {
+      i += 2;
+    } else if(strcmp(argv[i], "-w")) {
+      args.push_back(argv[i]);
+    }
+  }
+  args.push_back((char*)"-R");
+  args.push_back(sessionArg);
+  args.push_back(statePath);
+  args.push_back(nullptr);
+
+  fflush(stdout);
+  execv(argv[0], args.data());
+  fprintf(stderr, "No se pudo relanzar %s\n", argv[0]);
+  exit(1);
+}
+
+int main(int argc, char** argv) {
+  uint64_t loopCost = SIM_DEFAULT_LOOP_COST_US;
+  const char* tracePath = nullptr;
+  const char* statePath = nullptr;
+  int session = 0;
+
+  for(int i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "-q") && i + 1 < argc) {
+      loopCost = strtoull(argv[++i], nullptr, 10);
+    } else if(!strcmp(argv[i], "-v")) {
+      simSerialEcho = true;
+    } else if(!strcmp(argv[i], "-n")) {
+      simNkroHost = true;
+    } else if(!strcmp(argv[i], "-w")) {
+      simWatchdogBoot = true;
+    } else if(!strcmp(argv[i], "-f") && i + 1 < argc) {
+      simImageSize = strtoul(argv[++i], nullptr, 10) * 1024;
+    } else if(!strcmp(argv[i], "-R") && i + 2 < argc) {
+      session = atoi(argv[++i]);
+      statePath = argv[++i];
+    } else if(argv[i][0] == '-') {
+      usage();
+    } else {
+      tracePath = argv[i];
+    }
+  }
+
+  if(!tracePath) usage();
+
+  if(statePath) {
+    bool loaded = simLoadNonVolatile(statePath);
+    remove(statePath);
+    if(!loaded) {
+      fprintf(stderr, "No se pudo leer la flash guardada en %s\n", statePath);
+      return 1;
+    }
+  }
+
+  setup();
+
+  uint64_t origin = simMicros();
+  uint64_t endTime = 0;
+  bool rebootAtEnd = false;
+  if(!loadTrace(tracePath, session, origin, &endTime, &rebootAtEnd)) {
+    return 1;
+  }
+
+  printf("%10.3f ms  SETUP  completo\n", origin / 1000.0);
+
+  while(simMicros() < endTime) {
+    uint64_t start = simMicros();
+    loop();
+    simAdvance(loopCost);
+    simRecordLoop(simMicros() - start);
+  }
+
+  simPrintSummary(endTime - origin);
+
+  if(rebootAtEnd) {
+    printf("%10.3f ms  REINICIO  corte de energia\n", simMicros() / 1000.0);
+    reboot(argv, session + 1);
+  }
+  return 0;
+}
@@ -0,0 +1,384 @@
+#include "sim.h"
+#include "stm32f1xx.h"
+#include "stm32_hal_flash.h"
+#include "latency.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+SimCounters simCounters = {};
+
+// Latencia medida desde fuera del firmware: pulsación en el pin -> reporte
+static LatencyHistogram pressLatency;
+
+// ============= ESTADO INTERNO =============
+static uint64_t nowUs = 0;
+
+static bool pinLow[SIM_MAX_PINS];     // false = HIGH (pull-up por defecto)
+static void (*pinIsr[SIM_MAX_PINS])(void);
+static uint8_t pinIsrMode[SIM_MAX_PINS];
+
+static uint16_t buttonState = 0;
+static uint16_t lastReadButtons = 0;
+static bool pcfPresent = true;
+static bool busStuck = false;
+static bool scanSeen = false;
+static uint64_t lastScanUs = 0;
+
+static uint8_t eepromData[SIM_EEPROM_SIZE];
+static bool eepromReady = false;
+
+static uint32_t watchdogTimeoutUs = 0;
+static uint64_t watchdogLastReload = 0;
+
+static uint64_t hidBusyUntil = 0;
+
+static bool pressPending[16];
+static uint64_t pressTime[16];
+
+struct SimEvent {
+  uint64_t time;
+  uint32_t seq;
+  SimEventType type;
+  int arg0;
+  int arg1;
+  std::string text;
+};
+
+static std::vector<SimEvent> events;
+static size_t nextEvent = 0;
+static bool eventsSorted = true;
+
+// ============= RELOJ VIRTUAL =============
+uint64_t simMicros() {
+  return nowUs;
+}
+
+static void checkWatchdog() {
+  if(watchdogTimeoutUs == 0) return;
+
+  if(nowUs - watchdogLastReload > watchdogTimeoutUs) {
+    simCounters.watchdogTrips++;
+    printf("%10.3f ms  WATCHDOG  %.3f ms sin recarga\n",
+           nowUs / 1000.0, (nowUs - watchdogLastReload) / 1000.0);
+    watchdogLastReload = nowUs;
+  }
+}
+
+static void updatePcfInterrupt() {
+  bool asserted = pcfPresent && buttonState != lastReadButtons;
+  simSetPin(SIM_PCF8575_INT_PIN, !asserted);
+}
+
+static void applyEvent(const SimEvent& evt) {
+  switch(evt.type) {
+    case SIM_EVT_BUTTON:
+      if(evt.arg1) {
+        buttonState |= (1 << evt.arg0);
+      } else {
+        buttonState &= ~(1 << evt.arg0);
+      }
+      updatePcfInterrupt();
+      break;
+
+    case SIM_EVT_PRESS_MARK:
+      if(!pressPending[evt.arg0]) {
+        pressPending[evt.arg0] = true;
+        pressTime[evt.arg0] = nowUs;
+      }
+      break;
+
+    case SIM_EVT_PIN:
+      simSetPin(evt.arg0, evt.arg1 != 0);
+      break;
+
+    case SIM_EVT_I2C:
+      // arg0: 0 = desconectado, 1 = conectado, 2 = bus colgado
+      pcfPresent = evt.arg0 != 0;
+      busStuck = evt.arg0 == 2;
+      printf("%10.3f ms  I2C  PCF8575 %s\n", nowUs / 1000.0,
+             busStuck ? "bus colgado" : (pcfPresent ? "conectado" : "desconectado"));
+      updatePcfInterrupt();
+      break;
+
+    case SIM_EVT_SERIAL:
+      simSerialFeed(evt.text.c_str());
+      break;
+  }
+}
+
+void simAdvance(uint64_t us) {
+  if(!eventsSorted) {
+    std::stable_sort(events.begin() + nextEvent, events.end(),
+                     [](const SimEvent& a, const SimEvent& b) {
+                       return a.time < b.time;
+                     });
+    eventsSorted = true;
+  }
+
+  uint64_t target = nowUs + us;
+
+  while(nextEvent < events.size() && events[nextEvent].time <= target) {
+    simPeripheralsRun(events[nextEvent].time, false);
+    if(events[nextEvent].time > nowUs) {
+      nowUs = events[nextEvent].time;
+      checkWatchdog();
+    }
+    applyEvent(events[nextEvent]);
+    nextEvent++;
+  }
+
+  simPeripheralsRun(target, true);
+  nowUs = target;
+  checkWatchdog();
+}
+
+void simSchedule(uint64_t timeUs, SimEventType type, int arg0, int arg1,
+                 const char* text) {
+  SimEvent evt;
+  evt.time = timeUs;
+  evt.seq = events.size();
+  evt.type = type;
+  evt.arg0 = arg0;
+  evt.arg1 = arg1;
+  if(text) evt.text = text;
+
+  events.push_back(evt);
+  eventsSorted = false;
+}
+
+// ============= PINES GPIO =============
+void simSetPin(uint32_t pin, bool level) {
+  if(pin >= SIM_MAX_PINS) return;
+
+  bool wasLevel = !pinLow[pin];
+  pinLow[pin] = !level;
+
+  if(wasLevel == level || !pinIsr[pin]) return;
+
+  uint8_t mode = pinIsrMode[pin];
+  // CHANGE = 2, FALLING = 3, RISING = 4 (Arduino.h)
+  if(mode == 2 || (mode == 3 && !level) || (mode == 4 && level)) {
+    pinIsr[pin]();
+  }
+}
+
+void simAttachInterrupt(uint32_t pin, void (*callback)(void), uint32_t mode) {
+  if(pin >= SIM_MAX_PINS) return;
+  pinIsr[pin] = callback;
+  pinIsrMode[pin] = mode;
+}
+
+bool simGetPin(uint32_t pin) {
+  if(pin >= SIM_MAX_PINS) return true;
+  return !pinLow[pin];
+}
+
+// ============= PCF8575 / I2C =============
+uint16_t simGetButtons() {
+  return buttonState;
+}
+
+bool simPcfPresent() {
+  return pcfPresent;
+}
+
+void simI2CTransaction(uint8_t bytes) {
+  simCounters.i2cTransactions++;
+  // Dirección + datos, 9 bits por byte
+  simAdvance((uint64_t)(bytes + 1) * SIM_I2C_BYTE_US);
+}
+
+uint64_t simI2CStart(uint8_t bytes) {
+  simCounters.i2cTransactions++;
+  return (uint64_t)(bytes + 1) * SIM_I2C_BYTE_US;
+}
+
+bool simI2CBusStuck() {
+  return busStuck;
+}
+
+void simRecordButtonScan() {
+  if(scanSeen) {
+    uint64_t gap = nowUs - lastScanUs;
+    if(gap > simCounters.maxScanGapUs) {
+      simCounters.maxScanGapUs = gap;
+    }
+  }
+  scanSeen = true;
+  lastScanUs = nowUs;
+
+  lastReadButtons = buttonState;
+  updatePcfInterrupt();
+}
+
+// ============= EEPROM EMULADA =============
+static void eepromInit() {
+  if(eepromReady) return;
+  for(int i = 0; i < SIM_EEPROM_SIZE; i++) {
+    eepromData[i] = 0xFF;  // Flash borrada
+  }
+  eepromReady = true;
+}
+
+uint8_t simEepromRead(int address) {
+  eepromInit();
+  if(address < 0 || address >= SIM_EEPROM_SIZE) return 0xFF;
+  return eepromData[address];
+}
+
+void simEepromWrite(int address, uint8_t value) {
+  eepromInit();
+  if(address < 0 || address >= SIM_EEPROM_SIZE) return;
+
+  eepromData[address] = value;
+  simCounters.eepromWrites++;
+
+  // La emulación del core reescribe la página completa por cada byte
+  simCounters.flashErases++;
+  simAdvance(SIM_FLASH_ERASE_US + (SIM_EEPROM_SIZE / 2) * SIM_FLASH_PROGRAM_US);
+}
+
+// ============= MEMORIA NO VOLÁTIL =============
+bool simSaveNonVolatile(const char* path) {
+  eepromInit();
+  FILE* file = fopen(path, "wb");
+  if(!file) return false;
+
+  bool ok = fwrite(simFlash, 1, SIM_FLASH_SIZE, file) == SIM_FLASH_SIZE &&
+            fwrite(eepromData, 1, SIM_EEPROM_SIZE, file) == SIM_EEPROM_SIZE;
+  return fclose(file) == 0 && ok;
+}
+
+bool simLoadNonVolatile(const char* path) {
+  eepromInit();
+  FILE* file = fopen(path, "rb");
+  if(!file) return false;
+
+  bool ok = fread(simFlash, 1, SIM_FLASH_SIZE, file) == SIM_FLASH_SIZE &&
+            fread(eepromData, 1, SIM_EEPROM_SIZE, file) == SIM_EEPROM_SIZE;
+  fclose(file);
+  return ok;
+}
+
+// ============= WATCHDOG =============
+bool simWatchdogBoot = false;
+
+void simWatchdogBegin(uint32_t timeoutUs) {
+  watchdogTimeoutUs = timeoutUs;
+  watchdogLastReload = nowUs;
+}
+
+void simWatchdogReload() {
+  watchdogLastReload = nowUs;
+}
+
+// ============= USB HID =============
+static void recordLatency(const uint8_t* keys, uint8_t count) {
+  for(uint8_t b = 0; b < 16; b++) {
+    if(!pressPending[b]) continue;
+
+    uint8_t usage = simUsageForKeycode(simButtonKeycode(b));
+    for(uint8_t k = 0; k < count; k++) {
+      if(usage != 0 && keys[k] == usage) {
+        pressLatency.record(nowUs - pressTime[b]);
+
+        pressPending[b] = false;
+        break;
+      }
+    }
+  }
+}
+
+// Extraer usages del reporte: de arranque (8 bytes) o bitmap NKRO
+static uint8_t decodeReport(const uint8_t* report, uint16_t len, uint8_t* usages) {
+  uint8_t count = 0;
+
+  if(len == 8) {
+    for(uint16_t i = 2; i < len; i++) {
+      if(report[i] != 0) usages[count++] = report[i];
+    }
+  } else {
+    for(uint16_t i = 1; i < len; i++) {
+      for(uint8_t bit = 0; bit < 8; bit++) {
+        if(report[i] & (1 << bit)) usages[count++] = (i - 1) * 8 + bit;
+      }
+    }
+  }
+
+  return count;
+}
+
+void simHidSubmit(const uint8_t* report, uint16_t len) {
+  bool busy = nowUs < hidBusyUntil;
+  bool nkro = len != 8;
+
+  uint8_t usages[128];
+  uint8_t count = decodeReport(report, len, usages);
+
+  printf("%10.3f ms  %s%s mod=%02x keys=[", nowUs / 1000.0,
+         busy ? "HID-BUSY" : "HID     ", nkro ? " NKRO" : "",
+         len > 0 ? report[0] : 0);
+
+  for(uint8_t i = 0; i < count; i++) {
+    printf(i == 0 ? "%02x" : " %02x", usages[i]);
+  }
+  printf("]\n");
+
+  if(busy) {
+    simCounters.hidDropped++;
+    return;
+  }
+
+  simCounters.hidReports++;
+  hidBusyUntil = (nowUs / SIM_USB_POLL_US + 1) * SIM_USB_POLL_US;
+
+  recordLatency(usages, count);
+}
+
+// ============= ESTADÍSTICAS =============
+void simRecordLoop(uint64_t durationUs) {
+  simCounters.loops++;
+  if(durationUs > simCounters.maxLoopUs) {
+    simCounters.maxLoopUs = durationUs;
+  }
+  if(durationUs > 1000) {
+    simCounters.slowLoops++;
+  }
+}
+
+void simPrintSummary(uint64_t runUs) {
+  double seconds = runUs / 1000000.0;
+
+  printf("=== RESUMEN DE SIMULACION ===\n");
+  printf("Tiempo simulado: %.3f s\n", seconds);
+  printf("Loops: %lu (max %.3f ms, >1ms: %lu)\n", simCounters.loops,
+         simCounters.maxLoopUs / 1000.0, simCounters.slowLoops);
+  printf("Max intervalo entre escaneos: %.3f ms\n",
+         simCounters.maxScanGapUs / 1000.0);
+  printf("Transacciones I2C: %lu (%.1f/s)\n", simCounters.i2cTransactions,
+         seconds > 0 ? simCounters.i2cTransactions / seconds : 0.0);
+  printf("Reportes HID: %lu (perdidos por endpoint ocupado: %lu)\n",
+         simCounters.hidReports, simCounters.hidDropped);
+
+  if(pressLatency.getCount() > 0) {
+    printf("Latencia pulsacion->reporte: min %.3f ms, media %.3f ms, p50 %.3f ms, "
+           "p99 %.3f ms, max %.3f ms (n=%lu)\n",
+           pressLatency.getMin() / 1000.0, pressLatency.getMean() / 1000.0,
+           pressLatency.percentile(50) / 1000.0, pressLatency.percentile(99) / 1000.0,
+           pressLatency.getMax() / 1000.0, (unsigned long)pressLatency.getCount());
+  } else {
+    printf("Latencia pulsacion->reporte: sin muestras\n");
+  }
+
+  unsigned long unanswered = 0;
+  for(uint8_t b = 0; b < 16; b++) {
+    if(pressPending[b]) unanswered++;
+  }
+  printf("Pulsaciones sin reporte: %lu\n", unanswered);
+  printf("Escrituras EEPROM: %lu, flash: %lu medias palabras (borrados de pagina: %lu)\n",
+         simCounters.eepromWrites, simCounters.flashPrograms, simCounters.flashErases);
+  printf("Disparos de watchdog: %lu\n", simCounters.watchdogTrips);
+}
@@ -0,0 +1,121 @@
+#ifndef SIM_H
+#define SIM_H
+
+// Núcleo de la simulación en host: reloj virtual en microsegundos,
+// estado de pines/periféricos y registro del flujo de reportes HID.
+// Todos los mocks (Arduino, Wire, PCF8575, Keyboard, EEPROM, IWatchdog)
+// consultan este módulo en lugar de hardware real.
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ============= RELOJ VIRTUAL =============
+uint64_t simMicros();
+
+// Avanzar el reloj aplicando, en orden, los eventos del trace que vencen
+void simAdvance(uint64_t us);
+
+// ============= PINES GPIO =============
+#define SIM_MAX_PINS 64
+
+void simSetPin(uint32_t pin, bool level);
+bool simGetPin(uint32_t pin);
+
+// ISR asociada a un pin; mode: CHANGE, FALLING o RISING de Arduino.h
+void simAttachInterrupt(uint32_t pin, void (*callback)(void), uint32_t mode);
+
+// ============= PCF8575 / I2C =============
+// Bit i = 1 significa botón i presionado (el pin real queda en LOW)
+uint16_t simGetButtons();
+bool simPcfPresent();
+
+// Salida INT del PCF8575 (activa en LOW mientras las entradas difieren de
+// la última lectura), cableada a PB8 como PCF8575_INT_PIN
+#define SIM_PCF8575_INT_PIN 24
+
+// Costo de cada transacción I2C a 400kHz (bloquea el reloj)
+#define SIM_I2C_BYTE_US 23
+void simI2CTransaction(uint8_t bytes);
+// Transacción por interrupción: cuenta y devuelve su duración sin bloquear
+uint64_t simI2CStart(uint8_t bytes);
+// Bus colgado (trace "i2c stuck"): las transferencias en curso no terminan
+bool simI2CBusStuck();
+// Lectura completa del expansor: registra el intervalo y libera INT
+void simRecordButtonScan();
+
+// ============= EEPROM EMULADA =============
+#define SIM_EEPROM_SIZE 1024
+#define SIM_FLASH_ERASE_US 20000
+#define SIM_FLASH_PROGRAM_US 60
+
+uint8_t simEepromRead(int address);
+void simEepromWrite(int address, uint8_t value);
+
+// ============= MEMORIA NO VOLÁTIL =============
+// La flash y la EEPROM emulada sobreviven al "reboot" de un trace: se
+// vuelcan a un archivo antes de relanzar el simulador y se cargan antes
+// del nuevo setup()
+bool simSaveNonVolatile(const char* path);
+bool simLoadNonVolatile(const char* path);
+
+// ============= WATCHDOG =============
+void simWatchdogBegin(uint32_t timeoutUs);
+void simWatchdogReload();
+
+// El arranque simula un reset por watchdog (opción -w)
+extern bool simWatchdogBoot;
+
+// ============= USB HID =============
+// El endpoint queda ocupado hasta el siguiente poll del host (1ms);
+// un reporte enviado con el endpoint ocupado se pierde, igual que en
+// HID_Composite_keyboard_sendReport del core STM32.
+#define SIM_USB_POLL_US 1000
+
+// len == 8: reporte de arranque; otro tamaño: bitmap NKRO (mods + bitmap)
+void simHidSubmit(const uint8_t* report, uint16_t len);
+
+// El host acepta la interfaz NKRO (opción -n); si no, el firmware
+// debe volver al reporte de arranque
+extern bool simNkroHost;
+
+// ============= ENGANCHES HACIA EL SKETCH Y LOS MOCKS =============
+void setup();
+void loop();
+
+uint8_t simButtonKeycode(uint8_t buttonIndex);
+uint8_t simUsageForKeycode(uint8_t keycode);
+void simSerialFeed(const char* text);
+
+// ============= EVENTOS DEL TRACE =============
+enum SimEventType {
+  SIM_EVT_BUTTON,       // Cambio de nivel de un botón (con o sin rebote)
+  SIM_EVT_PRESS_MARK,   // Marca de latencia: primer flanco de una pulsación
+  SIM_EVT_PIN,          // Cambio de nivel en un pin GPIO
+  SIM_EVT_I2C,          // Conectar/desconectar el PCF8575 o colgar el bus
+  SIM_EVT_SERIAL        // Texto recibido por el puerto serie
+};
+
+void simSchedule(uint64_t timeUs, SimEventType type, int arg0, int arg1,
+                 const char* text = nullptr);
+
+// ============= ESTADÍSTICAS =============
+struct SimCounters {
+  unsigned long loops;
+  uint64_t maxLoopUs;
+  unsigned long slowLoops;          // loops de más de 1ms
+  unsigned long i2cTransactions;
+  uint64_t maxScanGapUs;            // mayor intervalo entre lecturas del PCF8575
+  unsigned long hidReports;
+  unsigned long hidDropped;
+  unsigned long eepromWrites;
+  unsigned long flashPrograms;      // medias palabras programadas con el HAL
+  unsigned long flashErases;
+  unsigned long watchdogTrips;
+};
+
+extern SimCounters simCounters;
+
+void simRecordLoop(uint64_t durationUs);
+void simPrintSummary(uint64_t runUs);
+
+#endif
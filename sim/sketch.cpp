@@ -0,0 +1,55 @@
+// Unidad de compilación del sketch para host. Hace lo mismo que el
+// preprocesador del IDE de Arduino: incluir Arduino.h, declarar los
+// prototipos y compilar keyboard.ino tal cual.
+
+#include <Arduino.h>
+
+// El IDE pone los prototipos después de los includes del sketch: los tipos
+// de config.h (LayerKey) ya están declarados
+#include "../keyboard/config.h"
+
+// ============= PROTOTIPOS DEL SKETCH =============
+void taskButtonEvents();
+void taskButtons();
+void taskEncoders();
+void taskMacros();
+void pcf8575ISR();
+bool isButtonScanDue();
+void processButtons();
+void pollButtonRead();
+void updateButtons(uint16_t allPins, unsigned long detectTime);
+void updateReportButtons();
+bool holdProfileChord(uint8_t button, uint16_t state, unsigned long now);
+void flushProfileChord();
+void pressButton(uint8_t button);
+void tapIfReleased(uint8_t button, uint16_t keys);
+bool processComboEvents();
+bool feedLeader(uint8_t keycode);
+void runLeaderAction(LayerKey action);
+void handleKeyAction(uint8_t button, LayerKey action, bool pressed);
+bool processTapDanceEvents();
+void switchProfile(uint8_t index);
+void handleButtonPress(uint8_t buttonIndex);
+void handleButtonRelease(uint8_t buttonIndex);
+void encoderAISR();
+void encoderBISR();
+uint8_t encoderRoom();
+void processEncoders();
+void processKeyBuffer();
+void checkConfigEntry();
+void handleEncoderGesture(int8_t dirA, int8_t dirB);
+void connectPCF8575();
+void checkI2CConnection();
+void handleI2CError();
+void printDebugInfo();
+void processSerialCommands();
+
+#include "../keyboard/keyboard.ino"
+
+// ============= ENGANCHES PARA LA SIMULACIÓN =============
+// Código que el reporte debería mostrar: el fijado por la capa al
+// presionar, o el de BUTTON_MAP si el botón todavía no se procesó
+uint8_t simButtonKeycode(uint8_t buttonIndex) {
+  uint8_t keycode = layerEngine.getActiveKeycodes()[buttonIndex];
+  return keycode ? keycode : BUTTON_MAP[buttonIndex].keycode;
+}
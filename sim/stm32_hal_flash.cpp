@@ -0,0 +1,62 @@
+#include "stm32_hal_flash.h"
+#include "sim.h"
+
+#include <string.h>
+
+uint8_t simFlash[SIM_FLASH_SIZE];
+uint32_t simImageSize = SIM_DEFAULT_IMAGE_SIZE;
+
+static bool flashLocked = true;
+
+// La flash sale de fábrica borrada
+static struct SimFlashInit {
+  SimFlashInit() { memset(simFlash, 0xFF, sizeof(simFlash)); }
+} simFlashInit;
+
+static bool inFlash(uintptr_t address, size_t length) {
+  return address >= FLASH_BASE && address + length <= FLASH_BASE + SIM_FLASH_SIZE;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void) {
+  flashLocked = false;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void) {
+  flashLocked = true;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef* pEraseInit, uint32_t* PageError) {
+  *PageError = 0xFFFFFFFF;
+  if(flashLocked || pEraseInit->TypeErase != FLASH_TYPEERASE_PAGES) return HAL_ERROR;
+
+  for(uint32_t i = 0; i < pEraseInit->NbPages; i++) {
+    uintptr_t page = pEraseInit->PageAddress + i * FLASH_PAGE_SIZE;
+    if((page - FLASH_BASE) % FLASH_PAGE_SIZE != 0 || !inFlash(page, FLASH_PAGE_SIZE)) {
+      *PageError = page - FLASH_BASE;
+      return HAL_ERROR;
+    }
+
+    memset((void*)page, 0xFF, FLASH_PAGE_SIZE);
+    simCounters.flashErases++;
+    simAdvance(SIM_FLASH_ERASE_US);
+  }
+
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uintptr_t Address, uint64_t Data) {
+  if(flashLocked || TypeProgram != FLASH_TYPEPROGRAM_HALFWORD) return HAL_ERROR;
+  if(Address % 2 != 0 || !inFlash(Address, 2)) return HAL_ERROR;
+
+  // PGERR: la media palabra no estaba borrada (salvo escribir 0x0000)
+  uint16_t* cell = (uint16_t*)Address;
+  uint16_t value = (uint16_t)Data;
+  if(*cell != 0xFFFF && value != 0x0000) return HAL_ERROR;
+
+  *cell = value;
+  simCounters.flashPrograms++;
+  simAdvance(SIM_FLASH_PROGRAM_US);
+  return HAL_OK;
+}
@@ -0,0 +1,46 @@
+#ifndef STM32_HAL_FLASH_H
+#define STM32_HAL_FLASH_H
+
+// Subconjunto del driver HAL de flash del STM32F103C8 que usa el diario de
+// configuración (journal.h). En el core real lo trae Arduino.h con el resto
+// del HAL. La flash de 64 KB es un arreglo del host que arranca borrado:
+// FLASH_BASE y las direcciones son uintptr_t para poder apuntar a él, y
+// leerla es leer memoria, como en el chip.
+//
+// Como en el hardware, solo se puede programar una media palabra borrada
+// (0xFFFF) y borrar o programar detiene a la CPU: el reloj virtual avanza
+// SIM_FLASH_ERASE_US por página y SIM_FLASH_PROGRAM_US por media palabra.
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+
+#define SIM_FLASH_SIZE (64 * 1024)
+
+extern uint8_t simFlash[SIM_FLASH_SIZE];
+
+#define FLASH_BASE      ((uintptr_t)simFlash)
+#define FLASH_PAGE_SIZE 0x400U
+
+// Tamaño de la imagen del firmware (opción -f); en el chip lo dan los
+// símbolos del linker script
+#define SIM_DEFAULT_IMAGE_SIZE (40 * 1024)
+extern uint32_t simImageSize;
+#define FLASH_IMAGE_END (FLASH_BASE + simImageSize)
+
+#define FLASH_TYPEERASE_PAGES       0x00U
+#define FLASH_BANK_1                0x01U
+#define FLASH_TYPEPROGRAM_HALFWORD  0x01U
+
+struct FLASH_EraseInitTypeDef {
+  uint32_t TypeErase;
+  uint32_t Banks;
+  uintptr_t PageAddress;
+  uint32_t NbPages;
+};
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef* pEraseInit, uint32_t* PageError);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uintptr_t Address, uint64_t Data);
+
+#endif
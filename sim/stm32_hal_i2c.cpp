@@ -0,0 +1,53 @@
+#include "stm32_hal_i2c.h"
+#include "Wire.h"
+
+// ============= HAL I2C SIMULADO =============
+// La transferencia se resuelve de forma perezosa al consultar el estado:
+// equivale a que la ISR de eventos de I2C1 haya corrido en simDoneUs.
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress,
+                                            uint8_t* pData, uint16_t Size) {
+  if(hi2c->State != HAL_I2C_STATE_READY) {
+    return HAL_BUSY;
+  }
+
+  hi2c->State = HAL_I2C_STATE_BUSY_RX;
+  hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+  hi2c->pBuffPtr = pData;
+  hi2c->XferSize = Size;
+  hi2c->Devaddress = DevAddress;
+  hi2c->simDoneUs = simMicros() + simI2CStart(Size);
+  return HAL_OK;
+}
+
+static void completeTransfer(I2C_HandleTypeDef* hi2c) {
+  // Bus colgado (SDA retenida por un esclavo): la ISR nunca termina
+  if(simI2CBusStuck() || simMicros() < hi2c->simDoneUs) {
+    return;
+  }
+
+  hi2c->State = HAL_I2C_STATE_READY;
+
+  if((hi2c->Devaddress >> 1) != SIM_PCF8575_ADDRESS || !simPcfPresent()) {
+    hi2c->ErrorCode = HAL_I2C_ERROR_AF;
+    return;
+  }
+
+  // Botones a GND: un botón presionado se lee como 0
+  uint16_t pins = ~simGetButtons();
+  for(uint16_t i = 0; i < hi2c->XferSize; i++) {
+    hi2c->pBuffPtr[i] = (i < 2) ? (uint8_t)(pins >> (8 * i)) : 0xFF;
+  }
+  simRecordButtonScan();
+}
+
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef* hi2c) {
+  if(hi2c->State == HAL_I2C_STATE_BUSY_RX) {
+    completeTransfer(hi2c);
+  }
+  return hi2c->State;
+}
+
+uint32_t HAL_I2C_GetError(I2C_HandleTypeDef* hi2c) {
+  return hi2c->ErrorCode;
+}
@@ -0,0 +1,41 @@
+#ifndef STM32_HAL_I2C_H
+#define STM32_HAL_I2C_H
+
+// Subconjunto del driver HAL de I2C del STM32F1 que usa el motor asíncrono
+// (i2c_async.h). En el core real lo trae Wire.h a través de twi.h; aquí la
+// transferencia "en interrupción" termina sola cuando el reloj virtual
+// alcanza el tiempo que tardaría en el bus, sin bloquear al sketch.
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+
+typedef enum {
+  HAL_I2C_STATE_RESET   = 0x00,
+  HAL_I2C_STATE_READY   = 0x20,
+  HAL_I2C_STATE_BUSY    = 0x24,
+  HAL_I2C_STATE_BUSY_TX = 0x21,
+  HAL_I2C_STATE_BUSY_RX = 0x22
+} HAL_I2C_StateTypeDef;
+
+#define HAL_I2C_ERROR_NONE    0x00000000U
+#define HAL_I2C_ERROR_BERR    0x00000001U
+#define HAL_I2C_ERROR_ARLO    0x00000002U
+#define HAL_I2C_ERROR_AF      0x00000004U
+#define HAL_I2C_ERROR_OVR     0x00000008U
+#define HAL_I2C_ERROR_TIMEOUT 0x00000020U
+
+struct I2C_HandleTypeDef {
+  HAL_I2C_StateTypeDef State;
+  uint32_t ErrorCode;
+  uint8_t* pBuffPtr;
+  uint16_t XferSize;
+  uint16_t Devaddress;
+  uint64_t simDoneUs;     // Instante virtual en que termina la transferencia
+};
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress,
+                                            uint8_t* pData, uint16_t Size);
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef* hi2c);
+uint32_t HAL_I2C_GetError(I2C_HandleTypeDef* hi2c);
+
+#endif
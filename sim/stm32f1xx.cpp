@@ -0,0 +1,86 @@
+#include "stm32f1xx.h"
+#include "sim.h"
+
+GPIO_TypeDef simGPIOA = {};
+TIM_TypeDef simTIM3 = {};
+DMA_Channel_TypeDef simDMA1_Channel3 = {};
+RCC_TypeDef simRCC = {};
+DWT_Type simDWT = {};
+CoreDebug_Type simCoreDebug = {};
+uint32_t SystemCoreClock = 72000000;
+
+// ============= TIM3 -> DMA1 CANAL 3 =============
+static uint64_t nextUpdateUs = 0;
+static bool timerRunning = false;
+
+static uint64_t timerPeriodUs() {
+  uint64_t ticks = (uint64_t)(TIM3->PSC + 1) * (TIM3->ARR + 1);
+  uint64_t period = ticks * 1000000ULL / SystemCoreClock;
+  return period ? period : 1;
+}
+
+static uint16_t sampleGpioA() {
+  uint16_t idr = 0;
+  for(uint32_t pin = 0; pin < 16; pin++) {
+    if(simGetPin(pin)) idr |= (1 << pin);
+  }
+  GPIOA->IDR = idr;
+  return idr;
+}
+
+static void dmaRequest() {
+  DMA_Channel_TypeDef* ch = DMA1_Channel3;
+  if(!(ch->CCR & DMA_CCR_EN) || ch->CNDTR == 0) return;
+
+  // Solo se emula periférico -> memoria de 16 bits (CPAR = &GPIOA->IDR)
+  uint16_t* memory = (uint16_t*)ch->CMAR;
+  static uint32_t transferSize = 0;
+  static uint32_t index = 0;
+  if(transferSize == 0 || index >= transferSize) {
+    transferSize = ch->CNDTR;
+    index = 0;
+  }
+
+  memory[index++] = sampleGpioA();
+  ch->CNDTR--;
+
+  if(ch->CNDTR == 0 && (ch->CCR & DMA_CCR_CIRC)) {
+    ch->CNDTR = transferSize;
+    index = 0;
+  }
+}
+
+void simPeripheralsRun(uint64_t untilUs, bool inclusive) {
+  bool enabled = (TIM3->CR1 & TIM_CR1_CEN) && (TIM3->DIER & TIM_DIER_UDE);
+  if(!enabled) {
+    timerRunning = false;
+    return;
+  }
+
+  if(!timerRunning) {
+    timerRunning = true;
+    nextUpdateUs = simMicros() + timerPeriodUs();
+  }
+
+  uint64_t period = timerPeriodUs();
+  while(nextUpdateUs < untilUs || (inclusive && nextUpdateUs == untilUs)) {
+    dmaRequest();
+    nextUpdateUs += period;
+  }
+}
+
+// ============= DWT CYCCNT =============
+static uint32_t virtualCycles() {
+  return (uint32_t)(simMicros() * (SystemCoreClock / 1000000));
+}
+
+SimCycleCounter::operator uint32_t() const {
+  bool running = (simDWT.CTRL & DWT_CTRL_CYCCNTENA_Msk) &&
+                 (simCoreDebug.DEMCR & CoreDebug_DEMCR_TRCENA_Msk);
+  return running ? virtualCycles() - offset : 0;
+}
+
+SimCycleCounter& SimCycleCounter::operator=(uint32_t value) {
+  offset = virtualCycles() - value;
+  return *this;
+}
@@ -0,0 +1,96 @@
+#ifndef STM32F1XX_H
+#define STM32F1XX_H
+
+// Registros CMSIS del STM32F103 que usa el muestreo de encoders por DMA
+// (EncoderSampler en encoder.h). Solo TIM3 disparando DMA1 canal 3 se
+// emula en el tiempo: en cada update del timer se copia GPIOA->IDR a la
+// memoria destino, con CNDTR descontando y volviendo a empezar en modo circular.
+// CPAR/CMAR son uintptr_t para poder guardar punteros del host.
+//
+// DWT->CYCCNT (profile.h) se deriva del reloj virtual a SystemCoreClock:
+// en la simulación solo avanza con delay() y con el costo de cada loop().
+
+#include <stdint.h>
+
+struct GPIO_TypeDef {
+  volatile uint32_t CRL, CRH, IDR, ODR, BSRR, BRR, LCKR;
+};
+
+struct TIM_TypeDef {
+  volatile uint32_t CR1, CR2, SMCR, DIER, SR, EGR, CCMR1, CCMR2, CCER, CNT, PSC, ARR;
+};
+
+struct DMA_Channel_TypeDef {
+  volatile uint32_t CCR, CNDTR;
+  volatile uintptr_t CPAR, CMAR;
+};
+
+struct RCC_TypeDef {
+  volatile uint32_t APB1ENR, AHBENR;
+};
+
+// Contador de ciclos: leerlo consulta el reloj virtual, escribirlo lo ajusta
+struct SimCycleCounter {
+  uint32_t offset;
+  operator uint32_t() const;
+  SimCycleCounter& operator=(uint32_t value);
+};
+
+struct DWT_Type {
+  volatile uint32_t CTRL;
+  SimCycleCounter CYCCNT;
+};
+
+struct CoreDebug_Type {
+  volatile uint32_t DEMCR;
+};
+
+extern GPIO_TypeDef simGPIOA;
+extern TIM_TypeDef simTIM3;
+extern DMA_Channel_TypeDef simDMA1_Channel3;
+extern RCC_TypeDef simRCC;
+extern DWT_Type simDWT;
+extern CoreDebug_Type simCoreDebug;
+
+#define GPIOA         (&simGPIOA)
+#define TIM3          (&simTIM3)
+#define DMA1_Channel3 (&simDMA1_Channel3)
+#define RCC           (&simRCC)
+#define DWT           (&simDWT)
+#define CoreDebug     (&simCoreDebug)
+
+#define RCC_APB1ENR_TIM3EN 0x00000002U
+#define RCC_AHBENR_DMA1EN  0x00000001U
+
+#define DWT_CTRL_CYCCNTENA_Msk     0x00000001U
+#define CoreDebug_DEMCR_TRCENA_Msk 0x01000000U
+
+#define TIM_CR1_CEN  0x0001U
+#define TIM_DIER_UDE 0x0100U
+#define TIM_EGR_UG   0x0001U
+
+#define DMA_CCR_EN      0x0001U
+#define DMA_CCR_CIRC    0x0020U
+#define DMA_CCR_MINC    0x0080U
+#define DMA_CCR_PSIZE_0 0x0100U
+#define DMA_CCR_MSIZE_0 0x0400U
+#define DMA_CCR_PL_1    0x2000U
+
+extern uint32_t SystemCoreClock;
+
+// Estado de retorno común a los drivers HAL (stm32f1xx_hal_def.h)
+typedef enum {
+  HAL_OK      = 0x00,
+  HAL_ERROR   = 0x01,
+  HAL_BUSY    = 0x02,
+  HAL_TIMEOUT = 0x03
+} HAL_StatusTypeDef;
+
+// Número de pin Arduino -> PinName -> bit dentro del puerto
+#define digitalPinToPinName(p) (p)
+#define STM_PIN(X) ((X) & 0xF)
+
+// Ejecutar los disparos de TIM3/DMA pendientes hasta el instante indicado
+void simPeripheralsRun(uint64_t untilUs, bool inclusive);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef USBD_HID_COMPOSITE_IF_H
+#define USBD_HID_COMPOSITE_IF_H
+
+// Interfaz de bajo nivel del HID compuesto del core STM32. En la simulación
+// cada reporte termina en simHidSubmit(), que lo registra con su timestamp.
+
+#include <stdint.h>
+
+void HID_Composite_keyboard_sendReport(uint8_t* report, uint16_t len);
+
+#endif